@@ -0,0 +1,493 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/db/connection_pool.hpp"
+#include "../src/db/db_handler.hpp"
+#include "../src/db/fuzzy_name_index.hpp"
+#include "../src/db/group_commit_queue.hpp"
+#include "../src/db/log_transfer.hpp"
+#include "../src/db/tea_journal.hpp"
+#include "../src/models/compact_tea_log.hpp"
+#include "../src/models/timestamp.hpp"
+#include "../src/utility/substring_matcher.hpp"
+
+namespace {
+
+constexpr size_t kSmall = 1000;
+constexpr size_t kMedium = 100000;
+constexpr size_t kLarge = 1000000;
+constexpr size_t kPageSize = 256;
+
+/// @brief about 2000 distinct tea names built from a few word lists
+const std::vector<std::string>& tea_names() {
+  static const std::vector<std::string> names = [] {
+    const char* origins[] = {"Darjeeling", "Assam",    "Yunnan",  "Fujian",
+                             "Uji",        "Shizuoka", "Nilgiri", "Ceylon",
+                             "Taiwan",     "Anxi",     "Wuyi",    "Kenya",
+                             "Nepal",      "Hunan",    "Kagoshima", "Jeju"};
+    const char* styles[] = {"Sencha",        "Gyokuro",     "Oolong",
+                            "Black",         "White Peony", "Pu-erh",
+                            "Matcha",        "Hojicha",     "Silver Needle",
+                            "Dragon Well",   "Tie Guan Yin", "Lapsang",
+                            "Genmaicha",     "Bancha",      "Kukicha",
+                            "Jasmine"};
+    const char* grades[] = {"",        " First Flush", " Second Flush",
+                            " Reserve", " Aged",       " Roasted",
+                            " Spring", " Autumn"};
+    std::vector<std::string> names;
+    for (const char* origin : origins) {
+      for (const char* style : styles) {
+        for (const char* grade : grades) {
+          names.push_back(std::string(origin) + " " + style + grade);
+        }
+      }
+    }
+    return names;
+  }();
+  return names;
+}
+
+std::filesystem::path bench_directory() {
+  const char* configured = std::getenv("TEA_BENCH_DIR");
+  return configured ? std::filesystem::path(configured)
+                    : std::filesystem::temp_directory_path();
+}
+
+void remove_database(const std::filesystem::path& path) {
+  for (const char* suffix : {"", "-wal", "-shm"}) {
+    std::filesystem::remove(path.string() + suffix);
+  }
+}
+
+/// @brief Path of a database holding the given number of synthetic entries,
+/// spread over three years and skewed towards a few favourite teas. It is
+/// generated through the importer on first use and reused afterwards.
+/// @param rows
+std::string generated_database(size_t rows) {
+  const std::filesystem::path path =
+      bench_directory() / ("tea_bench_" + std::to_string(rows) + ".db");
+  if (std::filesystem::exists(path)) {
+    TeaDatabase existing(path.string());
+    if (existing.count_tea_entries() == rows) return path.string();
+  }
+  remove_database(path);
+
+  const auto& names = tea_names();
+  std::mt19937 random(static_cast<unsigned>(rows));
+  std::geometric_distribution<size_t> favourite(0.02);
+  const std::int64_t start = 1640995200;  // 2022-01-01
+  std::uniform_int_distribution<std::int64_t> time(start,
+                                                   start + 3 * 365 * 86400);
+
+  std::stringstream csv;
+  csv << "tea_name,utc_time\n";
+  for (size_t i = 0; i < rows; ++i) {
+    csv << names[favourite(random) % names.size()] << ','
+        << format_timestamp(time(random)) << '\n';
+  }
+
+  TeaDatabase database(path.string());
+  TeaImporter(database).import_log(csv, TransferFormat::Csv);
+  database.checkpoint(SQLITE_CHECKPOINT_TRUNCATE);
+  return path.string();
+}
+
+/// @brief a fresh copy of a generated database for benchmarks that write,
+/// so the generated one keeps its size
+/// @param rows
+std::string scratch_database(size_t rows) {
+  const std::filesystem::path source = generated_database(rows);
+  const std::filesystem::path path =
+      bench_directory() /
+      ("tea_bench_" + std::to_string(rows) + "_scratch.db");
+  remove_database(path);
+  std::filesystem::copy_file(source, path);
+  return path.string();
+}
+
+/// @brief ids and keys of entries picked evenly through the log
+std::vector<TeaLogEntry> sample_entries(TeaDatabase& database, size_t count) {
+  const size_t total = database.count_tea_entries();
+  std::vector<TeaLogEntry> samples;
+  for (size_t i = 0; i < count && total > 0; ++i) {
+    auto page = database.find_tea_entries_after(std::nullopt,
+                                                i * total / count, 1);
+    if (!page.empty()) samples.push_back(page.front());
+  }
+  return samples;
+}
+
+/// @brief search terms of the given length cut from the tea names, so that
+/// most of them match something
+std::vector<std::string> search_terms(size_t length) {
+  std::vector<std::string> terms;
+  const auto& names = tea_names();
+  for (size_t i = 0; i < 16; ++i) {
+    const std::string& name = names[(i * 131) % names.size()];
+    const size_t start =
+        (i * 7) % (name.size() - std::min(name.size(), length) + 1);
+    terms.push_back(name.substr(start, length));
+  }
+  return terms;
+}
+
+/// @brief adds latency percentiles of the timed iterations as counters
+/// @param state
+/// @param seconds one sample per iteration
+void report_percentiles(benchmark::State& state,
+                        std::vector<double> seconds) {
+  if (seconds.empty()) return;
+  std::sort(seconds.begin(), seconds.end());
+  auto percentile = [&seconds](double p) {
+    const size_t index = static_cast<size_t>(p * (seconds.size() - 1));
+    return seconds[index] * 1e6;
+  };
+  state.counters["p50_us"] = percentile(0.50);
+  state.counters["p90_us"] = percentile(0.90);
+  state.counters["p99_us"] = percentile(0.99);
+  state.counters["max_us"] = seconds.back() * 1e6;
+}
+
+/// @brief times one call for a manual-time benchmark
+template <typename Work>
+double time_call(benchmark::State& state, Work&& work) {
+  const auto start = std::chrono::steady_clock::now();
+  work();
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  state.SetIterationTime(seconds);
+  return seconds;
+}
+
+/// @brief args: rows, whether the mirror is loaded
+void BM_LogTea(benchmark::State& state) {
+  TeaDatabase database(scratch_database(state.range(0)));
+  if (state.range(1)) database.load_mirror();
+  const auto& names = tea_names();
+  size_t next = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(database.log_tea(names[next++ % names.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief args: rows, batch size
+void BM_LogTeas(benchmark::State& state) {
+  TeaDatabase database(scratch_database(state.range(0)));
+  const auto& names = tea_names();
+  std::vector<std::string> batch;
+  for (long i = 0; i < state.range(1); ++i) {
+    batch.push_back(names[(i * 37) % names.size()]);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(database.log_teas(batch));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+/// @brief args: rows, whether each record is synced. The background fold
+/// runs alongside, and whatever it has not folded by the end is folded
+/// after timing stops; the iterations are fixed so that stays bounded.
+void BM_JournalAppend(benchmark::State& state) {
+  const std::string path = scratch_database(state.range(0));
+  const std::string journal_path = TeaJournal::path_for(path);
+  std::filesystem::remove(journal_path);
+  JournalOptions options;
+  options.sync_each_append = state.range(1) != 0;
+  {
+    TeaJournal journal(path, journal_path, options);
+    const auto& names = tea_names();
+    size_t next = 0;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(journal.append(names[next++ % names.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+  std::filesystem::remove(journal_path);
+}
+
+/// @brief args: rows. Every thread logs one tea per iteration through a
+/// shared queue and waits for its result, so a batch is committed once each
+/// thread has queued a tea.
+void BM_GroupCommit(benchmark::State& state) {
+  static std::unique_ptr<ConnectionPool> pool;
+  static std::unique_ptr<GroupCommitQueue> queue;
+  if (state.thread_index() == 0) {
+    pool = std::make_unique<ConnectionPool>(scratch_database(state.range(0)));
+    GroupCommitOptions options;
+    options.max_batch = static_cast<size_t>(state.threads());
+    queue = std::make_unique<GroupCommitQueue>(*pool, options);
+  }
+  const auto& names = tea_names();
+  size_t next = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        queue->enqueue(names[next++ % names.size()]).get());
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    queue.reset();
+    pool.reset();
+  }
+}
+
+/// @brief args: rows, term length, engine (0 SQLite, 1 mirror). Results are
+/// collected into a CompactTeaLog as the list model does.
+void BM_FindTeaEntries(benchmark::State& state) {
+  TeaDatabase database(generated_database(state.range(0)));
+  if (state.range(2)) {
+    if (!database.load_mirror()) {
+      state.SkipWithError("log does not fit the mirror budget");
+      return;
+    }
+  } else {
+    database.set_search_engine(SearchEngine::Sqlite);
+  }
+
+  const std::vector<std::string> terms = search_terms(state.range(1));
+  std::vector<double> samples;
+  size_t rows = 0;
+  for (auto _ : state) {
+    const std::string& term = terms[samples.size() % terms.size()];
+    CompactTeaLog entries;
+    samples.push_back(time_call(state, [&] {
+      database.find_tea_entries(
+          term, [&entries](const TeaLogRow& row) { entries.append(row); });
+    }));
+    rows += entries.size();
+  }
+  report_percentiles(state, std::move(samples));
+  state.counters["rows_per_search"] =
+      benchmark::Counter(static_cast<double>(rows),
+                         benchmark::Counter::kAvgIterations);
+}
+
+/// @brief one pool per generated log, shared by every benchmark thread
+ConnectionPool& shared_pool(size_t rows) {
+  static std::mutex mutex;
+  static std::map<size_t, std::unique_ptr<ConnectionPool>> pools;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& pool = pools[rows];
+  if (!pool) {
+    pool = std::make_unique<ConnectionPool>(generated_database(rows));
+  }
+  return *pool;
+}
+
+/// @brief args: rows. Each thread leases a pooled reader per search, so
+/// throughput across thread counts shows how far reads scale.
+void BM_PooledSearch(benchmark::State& state) {
+  ConnectionPool& pool = shared_pool(state.range(0));
+  const std::vector<std::string> terms = search_terms(3);
+  size_t searches = static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    ConnectionPool::Lease reader = pool.reader();
+    size_t rows = 0;
+    reader->find_tea_entries(terms[searches++ % terms.size()],
+                             [&rows](const TeaLogRow&) { ++rows; });
+    benchmark::DoNotOptimize(rows);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief args: distinct names, term length. Ranks names against terms cut
+/// from the tea names with one character misspelled, as typed into search.
+void BM_FuzzySearch(benchmark::State& state) {
+  FuzzyNameIndex index;
+  const auto& names = tea_names();
+  for (long i = 0; i < state.range(0); ++i) {
+    index.add(static_cast<int>(i), names[i % names.size()] + " Lot " +
+                                       std::to_string(i / names.size()));
+  }
+  std::vector<std::string> terms = search_terms(state.range(1));
+  for (std::string& term : terms) term[term.size() / 2] = 'x';
+
+  std::vector<double> latencies;
+  size_t matches = 0;
+  for (auto _ : state) {
+    const std::string& term = terms[latencies.size() % terms.size()];
+    latencies.push_back(
+        time_call(state, [&] { matches += index.search(term).size(); }));
+  }
+  report_percentiles(state, std::move(latencies));
+  state.counters["matches"] = benchmark::Counter(
+      static_cast<double>(matches), benchmark::Counter::kAvgIterations);
+}
+
+/// @brief args: engine. Scans a 64 MiB arena of tea names for a term that
+/// is not in it.
+void BM_SubstringMatcher(benchmark::State& state) {
+  std::string arena;
+  for (size_t i = 0; arena.size() < (64u << 20); ++i) {
+    arena += tea_names()[i % tea_names().size()];
+  }
+  const auto engine = static_cast<MatchEngine>(state.range(0));
+  const SubstringMatcher matcher("Qilin", engine);
+  state.SetLabel(match_engine_name(matcher.engine()));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(matcher.find(arena));
+  }
+  state.SetBytesProcessed(state.iterations() * arena.size());
+}
+
+/// @brief args: rows. Renames each sampled entry to another tea and, on the
+/// next iteration, back to its own, so every iteration times a real rename.
+void BM_UpdateTeaName(benchmark::State& state) {
+  TeaDatabase database(scratch_database(state.range(0)));
+  const std::vector<TeaLogEntry> samples = sample_entries(database, 64);
+  const auto& names = tea_names();
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    const size_t pair = latencies.size() / 2;
+    const TeaLogEntry& entry = samples[pair % samples.size()];
+    const std::string* other = &names[pair % names.size()];
+    if (*other == entry.tea_name) other = &names[(pair + 1) % names.size()];
+    const std::string& new_name =
+        latencies.size() % 2 ? entry.tea_name : *other;
+    latencies.push_back(time_call(
+        state, [&] { database.update_tea_name(entry.id, new_name); }));
+  }
+  report_percentiles(state, std::move(latencies));
+}
+
+/// @brief args: rows, entries of the deleted tea. The tea is logged again
+/// outside the timed part of each iteration.
+void BM_DeleteTea(benchmark::State& state) {
+  TeaDatabase database(scratch_database(state.range(0)));
+  const std::vector<std::string> batch(state.range(1), "Bench Delete Tea");
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    database.log_teas(batch);
+    latencies.push_back(
+        time_call(state, [&] { database.delete_tea("Bench Delete Tea"); }));
+  }
+  report_percentiles(state, std::move(latencies));
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+/// @brief args: rows. What the list model reads when showing the whole
+/// log: the row count and the first page.
+void BM_ListFirstPage(benchmark::State& state) {
+  TeaDatabase database(generated_database(state.range(0)));
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    latencies.push_back(time_call(state, [&] {
+      benchmark::DoNotOptimize(database.count_tea_entries());
+      benchmark::DoNotOptimize(
+          database.find_tea_page(TeaLogCursor(), kPageSize));
+    }));
+  }
+  report_percentiles(state, std::move(latencies));
+}
+
+/// @brief args: rows. The page after a cursor, as the list model reads when
+/// scrolling on from the page before.
+void BM_ListPageAfterKey(benchmark::State& state) {
+  TeaDatabase database(generated_database(state.range(0)));
+  const std::vector<TeaLogEntry> anchors = sample_entries(database, 64);
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    const TeaLogEntry& anchor = anchors[latencies.size() % anchors.size()];
+    const TeaLogCursor cursor(TeaLogKey{anchor.tea_name, anchor.id});
+    latencies.push_back(time_call(state, [&] {
+      benchmark::DoNotOptimize(database.find_tea_page(cursor, kPageSize));
+    }));
+  }
+  report_percentiles(state, std::move(latencies));
+}
+
+/// @brief args: rows. Reads the whole log into a CompactTeaLog.
+void BM_ListPopulateAll(benchmark::State& state) {
+  TeaDatabase database(generated_database(state.range(0)));
+  database.set_search_engine(SearchEngine::Sqlite);
+  for (auto _ : state) {
+    CompactTeaLog entries;
+    database.find_tea_entries(
+        "", [&entries](const TeaLogRow& row) { entries.append(row); });
+    benchmark::DoNotOptimize(entries.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void log_sizes(benchmark::internal::Benchmark* benchmark) {
+  for (long rows : {kSmall, kMedium, kLarge}) benchmark->Arg(rows);
+}
+
+}  // namespace
+
+BENCHMARK(BM_LogTea)
+    ->ArgsProduct({{kSmall, kMedium, kLarge}, {0, 1}})
+    ->ArgNames({"rows", "mirror"});
+BENCHMARK(BM_LogTeas)
+    ->ArgsProduct({{kSmall, kMedium, kLarge}, {100}})
+    ->ArgNames({"rows", "batch"});
+BENCHMARK(BM_JournalAppend)
+    ->ArgsProduct({{kSmall, kMedium}, {0, 1}})
+    ->ArgNames({"rows", "sync"})
+    ->Iterations(100000);
+BENCHMARK(BM_GroupCommit)
+    ->Arg(kSmall)
+    ->Arg(kMedium)
+    ->ArgName("rows")
+    ->ThreadRange(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FindTeaEntries)
+    ->ArgsProduct({{kSmall, kMedium, kLarge}, {1, 2, 3, 5, 8}, {0, 1}})
+    ->ArgNames({"rows", "term", "mirror"})
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PooledSearch)
+    ->Arg(kSmall)
+    ->Arg(kMedium)
+    ->ArgName("rows")
+    ->ThreadRange(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FuzzySearch)
+    ->ArgsProduct({{10000, 100000, 250000}, {5, 9}})
+    ->ArgNames({"names", "term"})
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SubstringMatcher)
+    ->DenseRange(0, 2)
+    ->ArgName("engine")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UpdateTeaName)
+    ->Apply(log_sizes)
+    ->ArgName("rows")
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_DeleteTea)
+    ->ArgsProduct({{kSmall, kMedium, kLarge}, {100}})
+    ->ArgNames({"rows", "deleted"})
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ListFirstPage)
+    ->Apply(log_sizes)
+    ->ArgName("rows")
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ListPageAfterKey)
+    ->Apply(log_sizes)
+    ->ArgName("rows")
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ListPopulateAll)
+    ->Apply(log_sizes)
+    ->ArgName("rows")
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
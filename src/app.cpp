@@ -8,21 +8,43 @@
 #include <gtkmm/dialog.h>
 #include <gtkmm/stacksidebar.h>
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <vector>
 
 #include "db/db_handler.hpp"
+#include "db/tea_statistics.hpp"
 #include "models/tea.hpp"
 #include "ui/ui_elements.hpp"
 #include "ui/ui_layout.hpp"
 #include "ui/ui_style.hpp"
+#include "utility/instrumentation.hpp"
 #include "utility/utility.hpp"
 
-App::~App() = default;
+/// @brief waits for the database to finish opening if the window is closed
+/// before it has, cutting short the reads for the search indexes, and folds
+/// whatever is still in the journal
+App::~App() {
+  m_journal.reset();
+  m_closing = true;
+  if (teadatabase) m_pool->interrupt_readers();
+  if (m_opener.joinable()) m_opener.join();
+}
 
-/// @brief constructor for the application
-App::App() : teadatabase("tea_database.db"), m_isPanelExpanded(false) {
+/// @brief Builds and shows the window straight away with a placeholder in
+/// place of the tea page, and opens the database in the background. The
+/// tea page is built once it is open.
+/// @param db_path the log to open
+/// @param use_journal log through the journal next to the database
+/// @param started when main was entered, for the startup report
+App::App(const std::string& db_path, bool use_journal,
+         Instrumentation::Clock::time_point started)
+    : m_databasePath(db_path),
+      m_startup(started),
+      m_useJournal(use_journal),
+      m_isPanelExpanded(false) {
   ui_style.initialize_styling();
 
   m_sidePanel = ui_elements.create_side_panel(m_profileButton, m_teaButton,
@@ -31,44 +53,230 @@ App::App() : teadatabase("tea_database.db"), m_isPanelExpanded(false) {
   m_sidePanel->get_style_context()->add_class(m_isPanelExpanded ? "expanded"
                                                                 : "collapsed");
 
-  ui_elements.setup_treeview(m_treeView, m_refTreeModel, m_colID, m_colName,
-                             m_colLocal, m_colUtc);
-
-  Gtk::Box* tea_content =
-      ui_elements.create_tea_content(m_entry, m_searchEntry, m_logButton,
-                                     m_deleteButton, m_editButton, m_treeView);
-  Gtk::Box* main_box = ui_elements.create_main_box(m_sidePanel, tea_content);
+  m_placeholder.set_text("Opening the tea log...");
+  m_placeholder.get_style_context()->add_class("placeholder");
+  m_pages.add(m_placeholder, "loading");
+  Gtk::Box* main_box = ui_elements.create_main_box(m_sidePanel, &m_pages);
 
   ui_layout.arrange_layout(*this, main_box);
   connect_signals();
-  PopulateTreeview("");
+  signal_map().connect([this] { m_startup.mark("window_mapped"); });
+
+  m_databaseOpened.connect(sigc::mem_fun(*this, &App::on_database_opened));
+  m_journalFolded.connect(sigc::mem_fun(*this, &App::on_journal_folded));
+  m_opener = std::thread(&App::open_database, this);
+  m_startup.mark("window_constructed");
+}
+
+/// @brief Opens the pool, which creates or migrates the schema if the file
+/// needs it, and tells the main thread. Then, on a reader, mirrors the log
+/// and indexes the tea names for typo tolerant search into the search
+/// indexes the readers share with the writer, and tells the main thread
+/// again. Runs on the opener thread, so it only sets m_pool and m_openError
+/// before the first emit, and after it only uses the pool.
+void App::open_database() {
+  try {
+    m_pool = std::make_unique<ConnectionPool>(m_databasePath);
+  } catch (const std::exception& e) {
+    m_openError = e.what();
+  }
+  m_databaseOpened.emit();
+  if (!m_pool) return;
+
+  if (!m_closing) {
+    try {
+      ConnectionPool::Lease reader = m_pool->reader();
+      reader->load_mirror();
+      reader->load_fuzzy_index();
+    } catch (const std::exception& e) {
+      std::cerr << "Error executing database query: " << e.what()
+                << std::endl;
+    }
+  }
+  m_databaseOpened.emit();
+}
+
+/// @brief Called twice by the opener thread. The first time, swaps the
+/// placeholder for the tea page now that the database is open. The second
+/// time, the search indexes are built and searches stop going to SQLite, so
+/// the opener is done and the startup report can be written.
+void App::on_database_opened() {
+  if (teadatabase) {
+    m_opener.join();
+    m_startup.mark("search_indexed");
+    if (startup_report_requested_from_environment()) {
+      m_startup.write_report(std::clog);
+    }
+    return;
+  }
+
+  if (!m_pool) {
+    m_opener.join();
+    std::cerr << "Error opening database: " << m_openError << std::endl;
+    m_placeholder.set_text("Could not open " + m_databasePath + ": " +
+                           m_openError);
+    return;
+  }
+  m_startup.mark("database_open");
+
+  m_writer.emplace(m_pool->writer());
+  teadatabase = &**m_writer;
+  m_searchWorker = std::make_unique<SearchWorker>(
+      *m_pool,
+      [this](const std::string& search_term, CompactTeaLog& entries,
+             bool similar) {
+        show_entries(search_term, std::move(entries), similar);
+      });
+
+  m_teaList = TeaListModel::create(*teadatabase);
+  ui_elements.setup_columnview(m_columnView, m_teaList, m_selection);
+  Gtk::Box* tea_content = ui_elements.create_tea_content(
+      m_entry, m_searchEntry, m_searchNote, m_logButton, m_deleteButton,
+      m_editButton, m_columnView);
+  m_pages.add(*tea_content, "tea");
+  if (m_useJournal) open_journal();
+  PopulateTeaList("");
+  if (m_pages.get_visible_child_name() == "loading") show_tea_content();
+  m_startup.mark("interactive");
+}
+
+/// @brief Opens the journal next to the database, which replays whatever a
+/// crash left in it. If it cannot be opened, as when another process has
+/// it, teas are logged straight into the database instead.
+void App::open_journal() {
+  try {
+    m_journal = std::make_unique<TeaJournal>(
+        m_databasePath, TeaJournal::path_for(m_databasePath),
+        JournalOptions(), [this](const std::vector<int>& entry_ids) {
+          {
+            std::lock_guard<std::mutex> lock(m_foldedMutex);
+            m_foldedIds.insert(m_foldedIds.end(), entry_ids.begin(),
+                               entry_ids.end());
+          }
+          m_journalFolded.emit();
+        });
+  } catch (const std::exception& e) {
+    std::cerr << "Error opening journal: " << e.what() << std::endl;
+  }
+}
+
+/// @brief catches the writer up with the entries the journal has folded in
+/// and adds them to the tea list
+void App::on_journal_folded() {
+  std::vector<int> entry_ids;
+  {
+    std::lock_guard<std::mutex> lock(m_foldedMutex);
+    entry_ids.swap(m_foldedIds);
+  }
+  if (entry_ids.empty()) return;
+
+  try {
+    teadatabase->load_logged_entries(entry_ids);
+  } catch (const std::exception& e) {
+    std::cerr << "Error executing database query: " << e.what() << std::endl;
+  }
+  if (!m_currentSearchTerm.empty() || m_searchWorker->busy()) {
+    refresh_search();
+    return;
+  }
+  for (const int id : entry_ids) apply_logged_entry(id);
+}
+
+/// @brief populates the tea list with the whole log, which is read lazily as
+/// it scrolls, or hands the search term to the background worker, which
+/// fills the list with the matching entries
+/// @param searchTerm
+void App::PopulateTeaList(const std::string& searchTerm) {
+  if (!searchTerm.empty()) {
+    m_searchWorker->search(searchTerm);
+    return;
+  }
+
+  m_searchWorker->cancel();
+  m_currentSearchTerm.clear();
+  m_searchNote.set_visible(false);
+  m_teaList->show_all();
+}
+
+/// @brief replaces the tea list contents with the results of a search,
+/// noting when no name contained the term and they are the teas with the
+/// most similar names instead
+/// @param searchTerm
+/// @param entries
+/// @param similar
+void App::show_entries(const std::string& searchTerm, CompactTeaLog entries,
+                       bool similar) {
+  m_currentSearchTerm = searchTerm;
+  if (similar) {
+    m_searchNote.set_text("No tea contains \"" + searchTerm +
+                          "\". Showing similar names.");
+  }
+  m_searchNote.set_visible(similar);
+  m_teaList->show_entries(std::move(entries));
+}
+
+/// @brief re-runs the search in the search entry on the background worker.
+/// Clearing the search goes straight back to the lazily read whole log.
+void App::refresh_search() {
+  PopulateTeaList(m_searchEntry.get_text());
 }
 
-/// @brief populates the TreeView of all current items in the data base or by
-/// search terms
-/// @param search_Term
-void App::PopulateTreeview(const std::string& searchTerm) {
-  m_refTreeModel->clear();
+/// @brief adds a newly logged entry to the tea list. The unfiltered view is
+/// ordered by name so the row is inserted in place; a filtered view is
+/// re-queried since the entry may not match the search, as is a view with a
+/// search still in flight that may have started before the write.
+/// @param tea_id
+void App::apply_logged_entry(int tea_id) {
+  if (!m_currentSearchTerm.empty() || m_searchWorker->busy()) {
+    refresh_search();
+    return;
+  }
 
   try {
-    auto query_results = teadatabase.find_tea_entries(searchTerm);
-    if (!query_results.empty()) {
-      utility.AddEntriesToTree(query_results, m_refTreeModel, m_colID,
-                               m_colName, m_colLocal, m_colUtc);
+    auto entry = teadatabase->find_tea_entry(tea_id);
+    if (entry) {
+      m_teaList->entry_logged(*entry);
     }
   } catch (const std::exception& e) {
     std::cerr << "Error executing database query: " << e.what() << std::endl;
   }
 }
 
-/// @brief uses the log_tea function
+/// @brief moves a renamed entry to its new place in the tea list
+/// @param tea_id
+/// @param old_name
+/// @param new_name
+void App::apply_renamed_entry(int tea_id, const std::string& old_name,
+                              const std::string& new_name) {
+  if (!m_currentSearchTerm.empty() || m_searchWorker->busy()) {
+    refresh_search();
+    return;
+  }
+
+  try {
+    m_teaList->entry_renamed(tea_id, old_name, new_name);
+  } catch (const std::exception& e) {
+    std::cerr << "Error executing database query: " << e.what() << std::endl;
+  }
+}
+
+/// @brief uses the log_tea function, or appends to the journal, whose fold
+/// adds the entry to the list once it is committed
 void App::on_log_button_clicked() {
   const std::string tea_name = m_entry.get_text();
-  if (!tea_name.empty()) {
-    teadatabase.log_tea(tea_name);
-    std::cout << "Logged tea: " << tea_name << std::endl;
+  if (!tea_name.empty() && m_journal) {
+    if (m_journal->append(tea_name) != 0) {
+      std::cout << "Journaled tea: " << tea_name << std::endl;
+      m_entry.set_text("");
+    } else {
+      std::cerr << "Too long to journal: " << tea_name << std::endl;
+    }
+  } else if (!tea_name.empty()) {
+    if (teadatabase->log_tea(tea_name)) {
+      std::cout << "Logged tea: " << tea_name << std::endl;
+      apply_logged_entry(teadatabase->last_insert_id());
+    }
     m_entry.set_text("");
-    PopulateTreeview();
   } else {
     std::cerr << "No tea name entered!" << std::endl;
   }
@@ -76,84 +284,110 @@ void App::on_log_button_clicked() {
 
 /// @brief edits an entry based on selecting an item
 void App::on_edit_button_clicked() {
-  auto iter = m_treeView.get_selection()->get_selected();
-  if (!iter) {
+  auto row =
+      std::dynamic_pointer_cast<TeaRow>(m_selection->get_selected_item());
+  if (!row) {
     std::cerr << "No tea selected for editing!" << std::endl;
     return;
   }
 
-  const int tea_id = (*iter)[m_colID];
-  const std::string tea_name = (*iter)[m_colName];
-
-  Gtk::Window* edit_window = ui_elements.create_edit_window(
-      tea_name, [this, tea_id, tea_name](const std::string& new_tea_name) {
-        if (!new_tea_name.empty() && new_tea_name != tea_name) {
-          try {
-            teadatabase.update_tea_name(tea_id, new_tea_name);
-            PopulateTreeview();
-          } catch (const std::exception& e) {
-            std::cerr << "Error updating tea name: " << e.what() << std::endl;
-          }
-        }
-      });
+  if (!m_editDialog) {
+    m_editDialog = std::make_unique<EditDialog>(
+        *this, sigc::mem_fun(*this, &App::on_edit_saved));
+  }
+  m_editDialog->edit(row->entry().id, row->entry().tea_name);
+}
 
-  edit_window->show();
+/// @brief renames the entry the edit dialog was opened for
+/// @param tea_id
+/// @param old_name
+/// @param new_name
+void App::on_edit_saved(int tea_id, const std::string& old_name,
+                        const std::string& new_name) {
+  if (new_name.empty() || new_name == old_name) return;
+  try {
+    if (teadatabase->update_tea_name(tea_id, new_name)) {
+      apply_renamed_entry(tea_id, old_name, new_name);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error updating tea name: " << e.what() << std::endl;
+  }
 }
 
 /// @brief uses the delete_tea function
 void App::on_delete_button_clicked() {
   const std::string tea_name = m_entry.get_text();
   if (!tea_name.empty()) {
-    teadatabase.delete_tea(tea_name);
+    std::vector<int> deleted_ids;
+    teadatabase->delete_tea(tea_name, deleted_ids);
     std::cout << "Attempted to delete tea: " << tea_name << std::endl;
-    PopulateTreeview();
+    try {
+      m_teaList->entries_deleted(tea_name, deleted_ids);
+    } catch (const std::exception& e) {
+      std::cerr << "Error executing database query: " << e.what()
+                << std::endl;
+    }
+    if (m_searchWorker->busy()) refresh_search();
   } else {
     std::cerr << "No tea name entered!" << std::endl;
   }
 }
 
-/// @brief populates the listbox with the search
-void App::on_search_changed() {
-  const std::string search_term = m_searchEntry.get_text();
-  PopulateTreeview(search_term);
-}
+/// @brief hands the search to the background worker, which populates the
+/// tea list once typing pauses
+void App::on_search_changed() { refresh_search(); }
 
 void App::on_toggle_button_clicked() {
   ui_elements.toggle_side_panel(*m_sidePanel, m_toggleButton,
                                 m_isPanelExpanded);
 }
 
-void App::replace_main_content(Gtk::Box* new_content) {
-  Gtk::Box* main_box = dynamic_cast<Gtk::Box*>(get_children().front());
-
-  if (!main_box || main_box->get_children().empty()) {
-    std::cerr << "Error: Main box or its child not found." << std::endl;
-    return;
-  }
-
-  Gtk::Widget* old_content_ptr = main_box->get_children().back();
-  main_box->remove(*old_content_ptr);
-  main_box->append(*new_content);
-}
-
+/// @brief switches to the tea page, or to its placeholder while the
+/// database is still opening
 void App::show_tea_content() {
-  if (is_tea_content_shown) return;
-  Gtk::Box* tea_content =
-      ui_elements.create_tea_content(m_entry, m_searchEntry, m_logButton,
-                                     m_deleteButton, m_editButton, m_treeView);
-
-  replace_main_content(tea_content);
-  current_content = tea_content;
-  is_tea_content_shown = true;
+  m_pages.set_visible_child(teadatabase ? "tea" : "loading");
 }
 
+/// @brief switches to the profile page, building it the first time and
+/// refreshing its figures every time
 void App::show_profile_content() {
-  Gtk::Box* profile_content = ui_elements.create_profile_content();
+  if (!teadatabase) return;
+  ScopedTimer timer("ui.profile_page");
+  if (!m_profilePage) {
+    m_profilePage = Gtk::make_managed<ProfilePage>(
+        [this] { export_instrumentation("tea_logger_metrics.json", false); },
+        [this] { export_instrumentation("tea_logger_trace.json", true); });
+    m_pages.add(*m_profilePage, "profile");
+  }
 
-  if (current_content != profile_content) {
-    replace_main_content(profile_content);
-    current_content = profile_content;
-    is_tea_content_shown = false;
+  try {
+    m_profilePage->show_statistics(StatisticsQuery(*teadatabase).summary());
+  } catch (const std::exception& e) {
+    std::cerr << "Error executing database query: " << e.what() << std::endl;
+  }
+  Instrumentation& instrumentation = Instrumentation::instance();
+  m_profilePage->show_performance(instrumentation.operations(),
+                                  instrumentation.counters());
+  m_pages.set_visible_child("profile");
+}
+
+/// @brief writes the instrumentation snapshot, or the recorded trace, to a
+/// file next to the database
+/// @param file_name
+/// @param trace
+void App::export_instrumentation(const std::string& file_name, bool trace) {
+  const std::filesystem::path path =
+      std::filesystem::path(m_databasePath).parent_path() / file_name;
+  std::ofstream output(path, std::ios::trunc);
+  if (trace) {
+    Instrumentation::instance().write_chrome_trace(output);
+  } else {
+    Instrumentation::instance().write_snapshot(output);
+  }
+  if (output) {
+    std::cout << "Wrote " << path.string() << std::endl;
+  } else {
+    std::cerr << "Failed writing " << path.string() << std::endl;
   }
 }
 
@@ -1,40 +1,84 @@
 #ifndef APP_HPP
 #define APP_HPP
 
+#include <glibmm/dispatcher.h>
 #include <glibmm/refptr.h>
 #include <gtkmm/box.h>
 #include <gtkmm/button.h>
+#include <gtkmm/columnview.h>
 #include <gtkmm/entry.h>
-#include <gtkmm/liststore.h>
+#include <gtkmm/label.h>
 #include <gtkmm/searchentry.h>
-#include <gtkmm/treeview.h>
+#include <gtkmm/singleselection.h>
+#include <gtkmm/stack.h>
 #include <gtkmm/window.h>
 #include <sqlite3.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/connection_pool.hpp"
 #include "db/db_handler.hpp"
+#include "db/tea_journal.hpp"
+#include "models/tea_list_model.hpp"
+#include "ui/edit_dialog.hpp"
+#include "ui/profile_page.hpp"
 #include "ui/ui_elements.hpp"
 #include "ui/ui_layout.hpp"
 #include "ui/ui_style.hpp"
+#include "utility/instrumentation.hpp"
+#include "utility/search_worker.hpp"
 #include "utility/utility.hpp"
 
 class App : public Gtk::Window {
  public:
-  App();
+  App(const std::string& db_path, bool use_journal = false,
+      Instrumentation::Clock::time_point started =
+          Instrumentation::Clock::now());
   ~App() override;
 
  protected:
-  TeaDatabase teadatabase;
+  std::string m_databasePath;
+  StartupTimeline m_startup;
+  // The pool is opened on a background thread so the window maps without
+  // waiting on the disk; until it is ready the tea page is a placeholder and
+  // teadatabase is null. From then on the main thread holds the pool's
+  // writer for as long as the window is open, and background searches lease
+  // the pool's readers. The opener thread stays on to build the search
+  // indexes on a reader.
+  std::thread m_opener;
+  std::atomic<bool> m_closing{false};
+  Glib::Dispatcher m_databaseOpened;
+  std::string m_openError;
+  std::unique_ptr<ConnectionPool> m_pool;
+  std::optional<ConnectionPool::Lease> m_writer;
+  TeaDatabase* teadatabase = nullptr;
+  std::unique_ptr<SearchWorker> m_searchWorker;
+  // With --journal, logged teas are appended to the journal and show up in
+  // the list once its fold thread has committed them; the entries each fold
+  // logged are handed to the main thread, which brings the writer's
+  // catalogue and search indexes up to date with them.
+  bool m_useJournal;
+  Glib::Dispatcher m_journalFolded;
+  std::mutex m_foldedMutex;
+  std::vector<int> m_foldedIds;
+  std::unique_ptr<TeaJournal> m_journal;
   UiElements ui_elements;
-  Utility utility;
   UiLayout ui_layout;
   UiStyle ui_style;
 
-  Gtk::Box* current_content = nullptr;
-  bool is_tea_content_shown = true;
-
   Gtk::Box* m_sidePanel;
-  Gtk::Box* m_current_main_content;
-  void replace_main_content(Gtk::Box* new_content);
+  // the pages switched between by the side panel; the profile page is built
+  // the first time it is shown
+  Gtk::Stack m_pages;
+  Gtk::Label m_placeholder;
+  ProfilePage* m_profilePage = nullptr;
+  std::unique_ptr<EditDialog> m_editDialog;
 
   Gtk::Button m_logButton, m_deleteButton, m_editButton, m_profileButton,
       m_teaButton, m_toggleButton;
@@ -42,24 +86,36 @@ class App : public Gtk::Window {
   bool m_isPanelExpanded = true;
 
   Gtk::SearchEntry m_searchEntry;
+  // says when the list shows teas with similar names, not matches
+  Gtk::Label m_searchNote;
   Gtk::Entry m_entry;
 
-  Gtk::TreeView m_treeView;
-  Glib::RefPtr<Gtk::ListStore> m_refTreeModel;
-
-  Gtk::TreeModelColumn<int> m_colID;
-  Gtk::TreeModelColumn<std::string> m_colName, m_colLocal, m_colUtc;
-
-  Gtk::TreeModelColumnRecord m_Columns;
+  Gtk::ColumnView m_columnView;
+  Glib::RefPtr<TeaListModel> m_teaList;
+  Glib::RefPtr<Gtk::SingleSelection> m_selection;
+  std::string m_currentSearchTerm;
 
+  void open_database();
+  void on_database_opened();
+  void open_journal();
+  void on_journal_folded();
   void on_toggle_button_clicked();
   void on_log_button_clicked();
   void on_edit_button_clicked();
+  void on_edit_saved(int tea_id, const std::string& old_name,
+                     const std::string& new_name);
   void show_tea_content();
   void show_profile_content();
+  void export_instrumentation(const std::string& file_name, bool trace);
   void on_search_changed();
   void on_delete_button_clicked();
-  void PopulateTreeview(const std::string& searchTerm = "");
+  void PopulateTeaList(const std::string& searchTerm = "");
+  void show_entries(const std::string& searchTerm, CompactTeaLog entries,
+                    bool similar);
+  void refresh_search();
+  void apply_logged_entry(int tea_id);
+  void apply_renamed_entry(int tea_id, const std::string& old_name,
+                           const std::string& new_name);
   void connect_signals();
 };
 
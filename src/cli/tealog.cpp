@@ -0,0 +1,266 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../db/db_handler.hpp"
+#include "../db/tea_journal.hpp"
+#include "../db/tea_statistics.hpp"
+#include "../models/timestamp.hpp"
+#include "../utility/instrumentation.hpp"
+#include "transfer_command.hpp"
+
+// Headless front end to the tea log, for scripts, batch jobs and machines
+// without a display:
+//   tealog [OPTIONS] log [NAME...]   names from stdin when none are given
+//   tealog [OPTIONS] search TERM
+//   tealog [OPTIONS] list [CURSOR]   one page, then "next" and its cursor
+//   tealog [OPTIONS] delete NAME
+//   tealog [OPTIONS] stats
+//   tealog --import|--export FILE [--format csv|jsonl] [--db PATH]
+// where OPTIONS are --db PATH, --metrics FILE to write the instrumentation
+// snapshot on exit, --trace FILE to record a Chrome trace into FILE and
+// --journal to log through the journal next to the database, which every
+// command replays first
+
+static constexpr size_t kLogBatchSize = 1000;
+static constexpr size_t kListPageSize = 100;
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program << " [OPTIONS] log [NAME...]\n"
+            << "       " << program << " [OPTIONS] search TERM\n"
+            << "       " << program << " [OPTIONS] list [CURSOR]\n"
+            << "       " << program << " [OPTIONS] delete NAME\n"
+            << "       " << program << " [OPTIONS] stats\n"
+            << "       " << program
+            << " --import|--export FILE [--format csv|jsonl] [--db PATH]\n"
+            << "Options: --db PATH, --metrics FILE, --trace FILE, --journal"
+            << std::endl;
+}
+
+/// @brief writes the instrumentation snapshot or trace to a file, if one
+/// was asked for
+static void write_instrumentation(const std::string& file, bool trace) {
+  if (file.empty()) return;
+  std::ofstream output(file, std::ios::trunc);
+  if (trace) {
+    Instrumentation::instance().write_chrome_trace(output);
+  } else {
+    Instrumentation::instance().write_snapshot(output);
+  }
+  if (!output) std::cerr << "Failed writing " << file << std::endl;
+}
+
+/// @brief logs the batch in one transaction and clears it
+/// @return number of teas that failed to log
+static size_t flush_batch(TeaDatabase& database,
+                          std::vector<std::string>& batch) {
+  size_t failed = 0;
+  for (const LogResult& result : database.log_teas(batch)) {
+    if (!result.success) ++failed;
+  }
+  batch.clear();
+  return failed;
+}
+
+/// @brief logs the named teas, or one tea per line of stdin, in batches
+static int log_command(TeaDatabase& database,
+                       const std::vector<std::string>& names) {
+  std::vector<std::string> batch;
+  size_t logged = 0;
+  size_t failed = 0;
+  auto add = [&](const std::string& name) {
+    if (name.empty()) return;
+    batch.push_back(name);
+    ++logged;
+    if (batch.size() == kLogBatchSize) failed += flush_batch(database, batch);
+  };
+
+  if (names.empty()) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      add(line);
+    }
+  } else {
+    for (const std::string& name : names) add(name);
+  }
+  failed += flush_batch(database, batch);
+
+  std::cerr << "Logged " << logged - failed << " teas, " << failed
+            << " failed" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
+
+/// @brief appends the named teas, or one tea per line of stdin, to the
+/// journal, and waits for them to be folded into the database
+static int journal_log_command(TeaJournal& journal,
+                               const std::vector<std::string>& names) {
+  size_t logged = 0;
+  size_t failed = 0;
+  auto add = [&](const std::string& name) {
+    if (name.empty()) return;
+    ++logged;
+    if (journal.append(name) == 0) {
+      std::cerr << "Too long to journal: " << name << std::endl;
+      ++failed;
+    }
+  };
+
+  if (names.empty()) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      add(line);
+    }
+  } else {
+    for (const std::string& name : names) add(name);
+  }
+  if (!journal.flush()) {
+    std::cerr << "Journaled " << logged - failed
+              << " teas, not yet in the database" << std::endl;
+    return 1;
+  }
+
+  std::cerr << "Logged " << logged - failed << " teas, " << failed
+            << " failed" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
+
+/// @brief prints the matching entries as tab separated id, name and local
+/// time. When none match, the teas with similar names are suggested on
+/// stderr rather than printed as results.
+static int search_command(TeaDatabase& database, const std::string& term) {
+  bool found = false;
+  database.find_tea_entries(term, [&found](const TeaLogRow& row) {
+    found = true;
+    std::cout << row.id << '\t' << row.tea_name << '\t'
+              << format_local_time(row.logged_at) << '\n';
+  });
+  if (found || term.empty()) return 0;
+
+  const std::vector<SimilarTea> similar = database.find_similar_teas(term, 5);
+  if (!similar.empty()) {
+    std::cerr << "No entries match \"" << term << "\". Similar teas:";
+    for (const SimilarTea& tea : similar) std::cerr << "\n  " << tea.tea_name;
+    std::cerr << std::endl;
+  }
+  return 0;
+}
+
+/// @brief prints one page of the log in name order like search does, then a
+/// line with "next" and the cursor to pass for the following page
+static int list_command(TeaDatabase& database, const std::string& token) {
+  std::optional<TeaLogCursor> cursor = TeaLogCursor::decode(token);
+  if (!cursor) {
+    std::cerr << "Invalid cursor: " << token << std::endl;
+    return 2;
+  }
+  const TeaLogPage page = database.find_tea_page(*cursor, kListPageSize);
+  for (const TeaLogEntry& entry : page.entries) {
+    std::cout << entry.id << '\t' << entry.tea_name << '\t'
+              << format_local_time(entry.logged_at) << '\n';
+  }
+  if (page.next) std::cout << "next\t" << page.next->encode() << '\n';
+  return 0;
+}
+
+static int delete_command(TeaDatabase& database, const std::string& name) {
+  std::vector<int> deleted_ids;
+  if (!database.delete_tea(name, deleted_ids)) return 1;
+  std::cerr << "Deleted " << deleted_ids.size() << " entries" << std::endl;
+  return 0;
+}
+
+static int stats_command(TeaDatabase& database) {
+  const TeaStatistics statistics = StatisticsQuery(database).summary();
+  std::cout << "entries\t" << statistics.total_entries << '\n'
+            << "teas\t" << statistics.distinct_teas << '\n'
+            << "days_logged\t" << statistics.days_logged << '\n'
+            << "current_streak\t" << statistics.current_streak << '\n'
+            << "longest_streak\t" << statistics.longest_streak << '\n';
+  for (const TeaCount& tea : statistics.top_teas) {
+    std::cout << "top\t" << tea.tea_name << '\t' << tea.count << '\n';
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (TransferCommand::matches(argc, argv)) {
+    return TransferCommand::run(argc, argv);
+  }
+
+  configure_instrumentation_from_environment();
+  std::string db_path;
+  std::string metrics_file;
+  std::string trace_file;
+  bool use_journal = false;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--db" && i + 1 < argc) {
+      db_path = argv[++i];
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      metrics_file = argv[++i];
+    } else if (arg == "--trace" && i + 1 < argc) {
+      trace_file = argv[++i];
+      Instrumentation::instance().set_tracing(true);
+    } else if (arg == "--journal") {
+      use_journal = true;
+    } else {
+      args.push_back(arg);
+    }
+  }
+  if (args.empty()) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  const std::string command = args.front();
+  const std::vector<std::string> operands(args.begin() + 1, args.end());
+  const bool takes_one = command == "search" || command == "delete";
+  const bool valid = (command == "log") ||
+                     (takes_one && operands.size() == 1) ||
+                     (command == "list" && operands.size() <= 1) ||
+                     (command == "stats" && operands.empty());
+  if (!valid) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  int status;
+  try {
+    if (db_path.empty()) db_path = default_database_path();
+    std::optional<TeaJournal> journal;
+    if (use_journal) {
+      journal.emplace(db_path, TeaJournal::path_for(db_path));
+      // fold in whatever a crashed run left behind before reading the log
+      if (journal->recovered() > 0 && !journal->flush()) {
+        throw std::runtime_error("could not replay the journal");
+      }
+    }
+
+    TeaDatabase database(db_path);
+    if (command == "log" && journal) {
+      status = journal_log_command(*journal, operands);
+    } else if (command == "log") {
+      status = log_command(database, operands);
+    } else if (command == "search") {
+      status = search_command(database, operands[0]);
+    } else if (command == "list") {
+      status = list_command(database, operands.empty() ? "" : operands[0]);
+    } else if (command == "delete") {
+      status = delete_command(database, operands[0]);
+    } else {
+      status = stats_command(database);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    status = 1;
+  }
+
+  write_instrumentation(metrics_file, false);
+  write_instrumentation(trace_file, true);
+  return status;
+}
@@ -0,0 +1,101 @@
+#include "transfer_command.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../db/db_handler.hpp"
+#include "../db/log_transfer.hpp"
+
+static void print_usage(const char* program) {
+  std::cerr << "Usage: " << program
+            << " --import|--export FILE [--format csv|jsonl] [--db PATH]"
+            << std::endl;
+}
+
+/// @brief whether the arguments ask for an import or export instead of the
+/// window
+bool TransferCommand::matches(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--import") == 0 ||
+        std::strcmp(argv[i], "--export") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief runs the import or export
+/// @return process exit code
+int TransferCommand::run(int argc, char* argv[]) {
+  bool importing = false;
+  std::string file;
+  std::string format_name;
+  std::string db_path;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if ((arg == "--import" || arg == "--export") && i + 1 < argc) {
+      importing = arg == "--import";
+      file = argv[++i];
+    } else if (arg == "--format" && i + 1 < argc) {
+      format_name = argv[++i];
+    } else if (arg == "--db" && i + 1 < argc) {
+      db_path = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+
+  TransferFormat format;
+  if (file.empty() ||
+      !transfer_format_from_name(format_name.empty() ? file : format_name,
+                                 format)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  try {
+    TeaDatabase database(db_path.empty() ? default_database_path() : db_path);
+    TransferStats stats;
+
+    if (importing) {
+      std::ifstream input_file;
+      if (file != "-") {
+        input_file.open(file, std::ios::binary);
+        if (!input_file) {
+          std::cerr << "Cannot open " << file << std::endl;
+          return 1;
+        }
+      }
+      std::istream& input = file == "-" ? std::cin : input_file;
+      stats = TeaImporter(database).import_log(input, format);
+      database.checkpoint(SQLITE_CHECKPOINT_TRUNCATE);
+      std::cerr << "Imported " << stats.rows << " teas, " << stats.failed
+                << " rejected" << std::endl;
+    } else {
+      std::ofstream output_file;
+      if (file != "-") {
+        output_file.open(file, std::ios::binary | std::ios::trunc);
+        if (!output_file) {
+          std::cerr << "Cannot open " << file << std::endl;
+          return 1;
+        }
+      }
+      std::ostream& output = file == "-" ? std::cout : output_file;
+      stats = TeaExporter(database).export_log(output, format);
+      output.flush();
+      if (!output) {
+        std::cerr << "Failed writing " << file << std::endl;
+        return 1;
+      }
+      std::cerr << "Exported " << stats.rows << " teas" << std::endl;
+    }
+    return stats.failed == 0 ? 0 : 1;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+}
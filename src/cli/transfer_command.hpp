@@ -0,0 +1,14 @@
+#ifndef TRANSFER_COMMAND_HPP
+#define TRANSFER_COMMAND_HPP
+
+/// @brief command line mode for bulk import and export, used as
+///   main --import FILE [--format csv|jsonl] [--db PATH]
+///   main --export FILE [--format csv|jsonl] [--db PATH]
+/// where FILE may be "-" for stdin or stdout
+class TransferCommand {
+ public:
+  static bool matches(int argc, char* argv[]);
+  static int run(int argc, char* argv[]);
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "connection_pool.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "../utility/instrumentation.hpp"
+
+/// @brief the options with the per-thread mode every pooled connection uses
+static ConnectionOptions pooled_options(ConnectionOptions options,
+                                        bool read_only) {
+  options.read_only = read_only;
+  options.no_mutex = true;
+  return options;
+}
+
+/// @brief opens the writer connection; readers are opened as they are needed
+/// @param db_path
+/// @param max_readers how many readers may be open at once, 0 for one per
+/// hardware thread
+/// @param options applied to every connection, which are all opened with
+/// SQLITE_OPEN_NOMUTEX and the readers read-only
+ConnectionPool::ConnectionPool(const std::string& db_path, size_t max_readers,
+                               const ConnectionOptions& options)
+    : m_path(db_path),
+      m_readerOptions(pooled_options(options, true)),
+      m_maxReaders(max_readers),
+      m_writer(db_path, pooled_options(options, false)) {
+  if (m_maxReaders == 0) {
+    m_maxReaders = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+/// @brief every lease must have ended before the pool is destroyed
+ConnectionPool::~ConnectionPool() = default;
+
+/// @brief leases the writer, waiting while another thread holds it
+/// @return the lease, which releases the writer when destroyed
+ConnectionPool::Lease ConnectionPool::writer() {
+  ScopedTimer timer("pool.lease_writer");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_released.wait(lock, [this] { return !m_writerLeased; });
+  m_writerLeased = true;
+  return Lease(this, &m_writer, true);
+}
+
+/// @brief leases an idle reader, opening another one if none is idle and
+/// fewer than max_readers are open, otherwise waiting for one to be released
+/// @return the lease, which returns the reader to the pool when destroyed
+ConnectionPool::Lease ConnectionPool::reader() {
+  ScopedTimer timer("pool.lease_reader");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_released.wait(lock, [this] {
+    return !m_idleReaders.empty() ||
+           m_readers.size() + m_openingReaders < m_maxReaders;
+  });
+  if (!m_idleReaders.empty()) {
+    TeaDatabase* database = m_idleReaders.back();
+    m_idleReaders.pop_back();
+    return Lease(this, database, false);
+  }
+
+  // opening a connection reads the schema, so it happens outside the lock
+  ++m_openingReaders;
+  lock.unlock();
+  std::unique_ptr<TeaDatabase> database;
+  try {
+    database = std::make_unique<TeaDatabase>(m_path, m_readerOptions);
+    database->share_search_indexes(m_writer);
+  } catch (...) {
+    lock.lock();
+    --m_openingReaders;
+    lock.unlock();
+    m_released.notify_one();
+    throw;
+  }
+  Instrumentation::instance().count("pool.readers_opened");
+
+  lock.lock();
+  --m_openingReaders;
+  m_readers.push_back(std::move(database));
+  return Lease(this, m_readers.back().get(), false);
+}
+
+/// @brief interrupts whatever the leased readers are running; safe to call
+/// from any thread
+void ConnectionPool::interrupt_readers() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& database : m_readers) database->interrupt();
+}
+
+/// @brief number of reader connections opened so far
+size_t ConnectionPool::open_readers() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_readers.size();
+}
+
+void ConnectionPool::release(TeaDatabase* database, bool writer) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (writer) {
+      m_writerLeased = false;
+    } else {
+      m_idleReaders.push_back(database);
+    }
+  }
+  // writers and readers wait on the same condition, so wake them all
+  m_released.notify_all();
+}
+
+ConnectionPool::Lease::Lease(ConnectionPool* pool, TeaDatabase* database,
+                             bool writer)
+    : m_pool(pool), m_database(database), m_writer(writer) {}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : m_pool(other.m_pool),
+      m_database(other.m_database),
+      m_writer(other.m_writer) {
+  other.m_pool = nullptr;
+}
+
+ConnectionPool::Lease::~Lease() {
+  if (m_pool) m_pool->release(m_database, m_writer);
+}
@@ -0,0 +1,78 @@
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "db_handler.hpp"
+
+/// @brief Shares one database file between threads. The pool owns a single
+/// writer connection and up to max_readers read-only ones, all opened with
+/// SQLITE_OPEN_NOMUTEX since each is only ever used by the thread leasing
+/// it, and each with its own statement cache. Leasing the writer waits for
+/// any other writer lease to end, so writes are serialized; readers are
+/// opened on first demand and handed to one thread at a time, and with WAL
+/// they read alongside each other and alongside the writer. Readers search
+/// the writer's in-memory mirror rather than loading one each.
+class ConnectionPool {
+ public:
+  /// @brief exclusive use of one pooled connection until destroyed
+  class Lease {
+   public:
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&&) = delete;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+
+    TeaDatabase& operator*() const { return *m_database; }
+    TeaDatabase* operator->() const { return m_database; }
+
+   private:
+    friend class ConnectionPool;
+    Lease(ConnectionPool* pool, TeaDatabase* database, bool writer);
+
+    ConnectionPool* m_pool;
+    TeaDatabase* m_database;
+    bool m_writer;
+  };
+
+  ConnectionPool(const std::string& db_path, size_t max_readers = 0,
+                 const ConnectionOptions& options = ConnectionOptions());
+  ~ConnectionPool();
+
+  ConnectionPool(const ConnectionPool&) = delete;
+  ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+  Lease writer();
+  Lease reader();
+  void interrupt_readers();
+
+  const std::string& path() const { return m_path; }
+  size_t max_readers() const { return m_maxReaders; }
+  size_t open_readers() const;
+
+ private:
+  void release(TeaDatabase* database, bool writer);
+
+  std::string m_path;
+  ConnectionOptions m_readerOptions;
+  size_t m_maxReaders;
+
+  // the writer is opened first, so it creates and migrates the schema and
+  // switches the file to WAL before any reader looks at it
+  TeaDatabase m_writer;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_released;
+  bool m_writerLeased = false;
+  size_t m_openingReaders = 0;
+  std::vector<std::unique_ptr<TeaDatabase>> m_readers;
+  std::vector<TeaDatabase*> m_idleReaders;
+};
+
+#endif
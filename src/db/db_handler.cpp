@@ -1,13 +1,67 @@
 #include "db_handler.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <thread>
 
-/// @brief Attempts to open the SQLite database
+/// @brief Where the log lives when no path is given. TEA_LOGGER_DB names the
+/// file outright. Otherwise a tea_database.db in the working directory, where
+/// older versions kept it, is still used, and failing that the log goes in
+/// $XDG_DATA_HOME/tea-logger (~/.local/share/tea-logger by default), which is
+/// created if needed.
+/// @return the path
+std::string default_database_path() {
+  if (const char* configured = std::getenv("TEA_LOGGER_DB");
+      configured && *configured) {
+    return configured;
+  }
+
+  std::error_code error;
+  if (std::filesystem::exists(kDefaultDatabasePath, error)) {
+    return kDefaultDatabasePath;
+  }
+
+  std::filesystem::path data_home;
+  if (const char* xdg = std::getenv("XDG_DATA_HOME"); xdg && *xdg) {
+    data_home = xdg;
+  } else if (const char* home = std::getenv("HOME"); home && *home) {
+    data_home = std::filesystem::path(home) / ".local" / "share";
+  } else {
+    return kDefaultDatabasePath;
+  }
+
+  const std::filesystem::path directory = data_home / "tea-logger";
+  std::filesystem::create_directories(directory, error);
+  if (error) return kDefaultDatabasePath;
+  return (directory / kDefaultDatabasePath).string();
+}
+
+/// @brief Attempts to open the SQLite database and configure the connection
 /// @param db_path
-SQLiteDB::SQLiteDB(const std::string& db_path) {
-  if (sqlite3_open(db_path.c_str(), &db) != SQLITE_OK) {
-    throw std::runtime_error("Failed to open database: " +
-                             std::string(sqlite3_errmsg(db)));
+/// @param options
+SQLiteDB::SQLiteDB(const std::string& db_path,
+                   const ConnectionOptions& options) {
+  int flags = options.read_only ? SQLITE_OPEN_READONLY
+                                : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+  if (options.no_mutex) flags |= SQLITE_OPEN_NOMUTEX;
+  if (sqlite3_open_v2(db_path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+    std::string error_msg =
+        "Failed to open database: " + std::string(sqlite3_errmsg(db));
+    sqlite3_close(db);
+    db = nullptr;
+    throw std::runtime_error(error_msg);
+  }
+
+  try {
+    configure(options);
+  } catch (...) {
+    sqlite3_close(db);
+    db = nullptr;
+    throw;
   }
 }
 
@@ -17,60 +71,943 @@ SQLiteDB::~SQLiteDB() {
   }
 }
 
+/// @brief names a statement after its SQL on one line
+static std::string statement_name(const char* sql) {
+  std::string name = "sql";
+  for (const char* c = sql; *c; ++c) {
+    const bool space = std::isspace(static_cast<unsigned char>(*c));
+    if (!space) {
+      name += *c;
+    } else if (name.back() != ' ') {
+      name += ' ';
+    }
+  }
+  if (name.back() == ' ') name.pop_back();
+  return name;
+}
+
+/// @brief sqlite3_trace_v2 callback timing each finished statement under its
+/// SQL text and reporting the slow ones
+static int trace_statement(unsigned type, void* context, void* statement,
+                           void* elapsed) {
+  if (type != SQLITE_TRACE_PROFILE) return 0;
+  auto* stmt = static_cast<sqlite3_stmt*>(statement);
+  const auto nanoseconds = *static_cast<sqlite3_int64*>(elapsed);
+  const std::chrono::nanoseconds duration(nanoseconds);
+
+  Instrumentation& instrumentation = Instrumentation::instance();
+  instrumentation.record(statement_name(sqlite3_sql(stmt)),
+                         Instrumentation::Clock::now() - duration, duration);
+  if (nanoseconds >= *static_cast<const sqlite3_int64*>(context)) {
+    instrumentation.count("sql.slow_statements");
+    char* expanded = sqlite3_expanded_sql(stmt);
+    std::cerr << "Slow statement (" << nanoseconds / 1e6
+              << " ms): " << (expanded ? expanded : sqlite3_sql(stmt))
+              << std::endl;
+    sqlite3_free(expanded);
+  }
+  return 0;
+}
+
+/// @brief applies the connection pragmas. The journal mode is a property of
+/// the database file, so only writers set it.
+/// @param options
+void SQLiteDB::configure(const ConnectionOptions& options) {
+  sqlite3_busy_timeout(db, options.busy_timeout_ms);
+  if (options.slow_statement_us >= 0) {
+    slow_statement_ns = options.slow_statement_us * 1000;
+    sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, trace_statement,
+                     &slow_statement_ns);
+  }
+
+  static const char* const synchronous_levels[] = {"OFF", "NORMAL", "FULL"};
+  std::string pragmas =
+      "PRAGMA synchronous = " +
+      std::string(synchronous_levels[static_cast<int>(options.synchronous)]) +
+      ";"
+      "PRAGMA mmap_size = " +
+      std::to_string(options.mmap_size) +
+      ";"
+      "PRAGMA cache_size = -" +
+      std::to_string(options.cache_size_kib) +
+      ";"
+      "PRAGMA temp_store = " +
+      (options.temp_store_memory ? "MEMORY" : "DEFAULT") + ";";
+  if (!options.read_only) {
+    pragmas += "PRAGMA journal_mode = " + options.journal_mode +
+               ";"
+               "PRAGMA wal_autocheckpoint = " +
+               std::to_string(options.wal_autocheckpoint_pages) +
+               ";"
+               "PRAGMA journal_size_limit = " +
+               std::to_string(options.journal_size_limit) + ";";
+  }
+
+  char* errMessage = nullptr;
+  if (sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, &errMessage) !=
+      SQLITE_OK) {
+    std::string error_msg =
+        "Failed to configure database: " +
+        std::string(errMessage ? errMessage : sqlite3_errmsg(db));
+    sqlite3_free(errMessage);
+    throw std::runtime_error(error_msg);
+  }
+}
+
+/// @brief copies the WAL back into the database file. Passive checkpoints
+/// never wait on readers; a truncating checkpoint also resets the WAL file.
+/// @param mode one of the SQLITE_CHECKPOINT_* modes
+/// @return false if the checkpoint could not complete
+bool SQLiteDB::checkpoint(int mode) {
+  return sqlite3_wal_checkpoint_v2(db, nullptr, mode, nullptr, nullptr) ==
+         SQLITE_OK;
+}
+
 sqlite3* SQLiteDB::get() const { return db; }
 
-/// @brief Creates a database if one does not exist
+// how many times a read-only connection rereads the log for the search
+// indexes when the writer keeps writing while it reads
+static constexpr int kIndexLoadAttempts = 3;
+
+/// @brief Marks a write in flight on the search indexes for as long as it
+/// lives: the generation is odd from before the write reaches SQLite until
+/// the indexes have it too, so a copy read from another connection in the
+/// meantime is never installed.
+class IndexWriteScope {
+ public:
+  explicit IndexWriteScope(SearchIndexes& indexes) : m_indexes(indexes) {
+    std::unique_lock<std::shared_mutex> lock(m_indexes.mutex);
+    ++m_indexes.generation;
+  }
+  ~IndexWriteScope() {
+    std::unique_lock<std::shared_mutex> lock(m_indexes.mutex);
+    ++m_indexes.generation;
+  }
+
+  IndexWriteScope(const IndexWriteScope&) = delete;
+  IndexWriteScope& operator=(const IndexWriteScope&) = delete;
+
+ private:
+  SearchIndexes& m_indexes;
+};
+
+/// @brief reads a text column without copying it
+/// @param stmt
+/// @param column
+/// @return view of the column, valid until the statement steps again
+static std::string_view column_view(sqlite3_stmt* stmt, int column) {
+  const auto* text =
+      reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+  if (!text) return {};
+  return {text, static_cast<size_t>(sqlite3_column_bytes(stmt, column))};
+}
+
+/// @brief Creates a database if one does not exist. A log already at the
+/// current schema version is opened without running any migration; a
+/// read-only database leaves the schema untouched and only detects the
+/// search index.
 /// @param db_path
-TeaDatabase::TeaDatabase(const std::string& db_path) : db(db_path) {
+/// @param options
+TeaDatabase::TeaDatabase(const std::string& db_path,
+                         const ConnectionOptions& options)
+    : db(db_path, options),
+      statements(db.get()),
+      read_only(options.read_only),
+      indexes(std::make_shared<SearchIndexes>()) {
+  indexes->mirror_budget = options.read_only ? 0 : options.mirror_budget_bytes;
+  ScopedTimer timer("db.open");
+  if (options.read_only) {
+    has_search_index = table_exists("tea_name_search");
+    return;
+  }
+
+  if (schema_version() < kSchemaVersion) {
+    create_schema();
+  } else {
+    has_search_index = table_exists("tea_name_search");
+  }
+  reload_catalogue();
+}
+
+/// @brief the schema version stamped in the database header
+int TeaDatabase::schema_version() {
+  sqlite3_stmt* stmt = prepare_statement("PRAGMA user_version;");
+  int version = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+  finalize_statement(stmt);
+  return version;
+}
+
+/// @brief Creates the tables, indexes, triggers and views, migrating logs
+/// written by earlier versions, then stamps the schema version so later
+/// opens can skip all of it. Every step is safe to run again.
+void TeaDatabase::create_schema() {
+  ScopedTimer timer("db.create_schema");
   execute_sql(R"(
-      CREATE TABLE IF NOT EXISTS tea_database (
+      CREATE TABLE IF NOT EXISTS teas (
+          id INTEGER PRIMARY KEY,
+          name TEXT NOT NULL UNIQUE,
+          log_count INTEGER NOT NULL DEFAULT 0
+      );
+      CREATE TABLE IF NOT EXISTS tea_log (
           id INTEGER PRIMARY KEY AUTOINCREMENT,
-          tea_name TEXT NOT NULL,
-          local_time DATE DEFAULT (datetime('now', 'localtime')),
-          utc_time DATE DEFAULT (datetime('now', 'utc'))
+          tea_id INTEGER NOT NULL REFERENCES teas (id),
+          logged_at INTEGER NOT NULL DEFAULT (unixepoch())
       );
   )");
+  migrate_text_timestamps();
+  migrate_to_catalogue();
+  execute_sql(R"(
+      CREATE INDEX IF NOT EXISTS tea_log_tea_index ON tea_log (tea_id, id);
+      CREATE INDEX IF NOT EXISTS tea_log_time_index ON tea_log (logged_at);
+
+      CREATE TRIGGER IF NOT EXISTS tea_count_insert
+      AFTER INSERT ON tea_log BEGIN
+          UPDATE teas SET log_count = log_count + 1 WHERE id = new.tea_id;
+      END;
+      CREATE TRIGGER IF NOT EXISTS tea_count_delete
+      AFTER DELETE ON tea_log BEGIN
+          UPDATE teas SET log_count = log_count - 1 WHERE id = old.tea_id;
+      END;
+      CREATE TRIGGER IF NOT EXISTS tea_count_update
+      AFTER UPDATE OF tea_id ON tea_log BEGIN
+          UPDATE teas SET log_count = log_count - 1 WHERE id = old.tea_id;
+          UPDATE teas SET log_count = log_count + 1 WHERE id = new.tea_id;
+      END;
+
+      CREATE VIEW IF NOT EXISTS tea_database AS
+      SELECT l.id AS id, t.name AS tea_name, l.logged_at AS logged_at
+      FROM tea_log l JOIN teas t ON t.id = l.tea_id;
+  )");
+  create_search_index();
+  create_statistics_rollups();
+  execute_sql("PRAGMA user_version = " + std::to_string(kSchemaVersion) +
+              ";");
 }
 
-sqlite3_stmt* TeaDatabase::prepare_statement(const std::string& sql) {
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db.get(), sql.c_str(), -1, &stmt, nullptr) !=
-      SQLITE_OK) {
-    throw std::runtime_error("SQL prepare error: " +
-                             std::string(sqlite3_errmsg(db.get())));
+/// @brief Converts a log created with text local_time and utc_time columns
+/// to the integer logged_at column. SQLite cannot change a column's type in
+/// place, so the table is copied with its ids and AUTOINCREMENT counter and
+/// swapped in, ready for migrate_to_catalogue.
+void TeaDatabase::migrate_text_timestamps() {
+  if (!column_exists("tea_database", "utc_time")) return;
+
+  try {
+    execute_sql(R"(
+        BEGIN IMMEDIATE;
+        CREATE TABLE tea_database_migrated (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            tea_name TEXT NOT NULL,
+            logged_at INTEGER NOT NULL DEFAULT (unixepoch())
+        );
+        INSERT INTO tea_database_migrated (id, tea_name, logged_at)
+        SELECT id, tea_name,
+               coalesce(unixepoch(utc_time), unixepoch(local_time, 'utc'), 0)
+        FROM tea_database ORDER BY id;
+        UPDATE sqlite_sequence
+        SET seq = max(seq, (SELECT seq FROM sqlite_sequence
+                            WHERE name = 'tea_database'))
+        WHERE name = 'tea_database_migrated';
+        DROP TABLE tea_database;
+        ALTER TABLE tea_database_migrated RENAME TO tea_database;
+        COMMIT;
+    )");
+  } catch (const std::exception&) {
+    sqlite3_exec(db.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+    throw;
+  }
+}
+
+/// @brief Splits a log kept as one tea_database table, which repeats the
+/// name on every row, into the teas catalogue and tea_log rows referencing
+/// it. Entry ids and the AUTOINCREMENT counter carry over; the old table,
+/// its triggers and its search index are dropped and tea_database becomes
+/// a view of the same shape.
+void TeaDatabase::migrate_to_catalogue() {
+  if (!table_exists("tea_database")) return;
+
+  try {
+    execute_sql(R"(
+        BEGIN IMMEDIATE;
+        INSERT INTO teas (name)
+        SELECT DISTINCT tea_name FROM tea_database WHERE true
+        ORDER BY tea_name
+        ON CONFLICT (name) DO NOTHING;
+        INSERT INTO tea_log (id, tea_id, logged_at)
+        SELECT d.id, t.id, d.logged_at
+        FROM tea_database d JOIN teas t ON t.name = d.tea_name
+        ORDER BY d.id;
+        UPDATE teas
+        SET log_count = (SELECT count(*) FROM tea_log WHERE tea_id = teas.id);
+        UPDATE sqlite_sequence
+        SET seq = max(seq, (SELECT seq FROM sqlite_sequence
+                            WHERE name = 'tea_database'))
+        WHERE name = 'tea_log';
+        DROP TABLE tea_database;
+        DROP TABLE IF EXISTS tea_name_search;
+        COMMIT;
+    )");
+  } catch (const std::exception&) {
+    sqlite3_exec(db.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+    throw;
+  }
+}
+
+/// @brief Creates the trigram full text index over the catalogue's names and
+/// the triggers keeping it in sync. Each distinct name is indexed once, not
+/// once per log entry. Databases created before the index existed are
+/// backfilled once. If SQLite was built without FTS5 searches keep using LIKE.
+void TeaDatabase::create_search_index() {
+  try {
+    bool index_exists = table_exists("tea_name_search");
+
+    execute_sql(R"(
+        BEGIN;
+        CREATE VIRTUAL TABLE IF NOT EXISTS tea_name_search USING fts5(
+            name,
+            content = 'teas',
+            content_rowid = 'id',
+            tokenize = 'trigram'
+        );
+        CREATE TRIGGER IF NOT EXISTS tea_search_insert
+        AFTER INSERT ON teas BEGIN
+            INSERT INTO tea_name_search (rowid, name) VALUES (new.id, new.name);
+        END;
+        CREATE TRIGGER IF NOT EXISTS tea_search_delete
+        AFTER DELETE ON teas BEGIN
+            INSERT INTO tea_name_search (tea_name_search, rowid, name)
+            VALUES ('delete', old.id, old.name);
+        END;
+        CREATE TRIGGER IF NOT EXISTS tea_search_update
+        AFTER UPDATE OF name ON teas BEGIN
+            INSERT INTO tea_name_search (tea_name_search, rowid, name)
+            VALUES ('delete', old.id, old.name);
+            INSERT INTO tea_name_search (rowid, name) VALUES (new.id, new.name);
+        END;
+    )");
+    if (!index_exists) {
+      execute_sql(
+          "INSERT INTO tea_name_search (tea_name_search) VALUES ('rebuild');");
+    }
+    execute_sql("COMMIT;");
+    has_search_index = true;
+  } catch (const std::exception& e) {
+    sqlite3_exec(db.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+    has_search_index = false;
+    std::cerr << "Full text search unavailable, using LIKE: " << e.what()
+              << std::endl;
+  }
+}
+
+/// @brief Creates the summary tables behind the profile statistics: log
+/// counts per local calendar day and per hour of the week. Triggers on
+/// tea_log keep them current for every connection, so reading statistics
+/// never scans the log. Existing logs are summarised once when the tables
+/// are first created. Days and hours are taken in the local time zone of
+/// the connection doing the write.
+void TeaDatabase::create_statistics_rollups() {
+  const bool rollups_exist = table_exists("tea_daily_counts");
+
+  try {
+    execute_sql(R"(
+        BEGIN;
+        CREATE TABLE IF NOT EXISTS tea_daily_counts (
+            day INTEGER PRIMARY KEY,
+            count INTEGER NOT NULL
+        );
+        CREATE TABLE IF NOT EXISTS tea_hourly_counts (
+            hour_of_week INTEGER PRIMARY KEY,
+            count INTEGER NOT NULL
+        );
+        CREATE INDEX IF NOT EXISTS teas_count_index ON teas (log_count);
+
+        CREATE TRIGGER IF NOT EXISTS tea_rollup_insert
+        AFTER INSERT ON tea_log BEGIN
+            INSERT INTO tea_daily_counts (day, count)
+            VALUES (unixepoch(new.logged_at, 'unixepoch', 'localtime') / 86400,
+                    1)
+            ON CONFLICT (day) DO UPDATE SET count = count + 1;
+            INSERT INTO tea_hourly_counts (hour_of_week, count)
+            VALUES (strftime('%w', new.logged_at, 'unixepoch', 'localtime') * 24
+                    + strftime('%H', new.logged_at, 'unixepoch', 'localtime'),
+                    1)
+            ON CONFLICT (hour_of_week) DO UPDATE SET count = count + 1;
+        END;
+        CREATE TRIGGER IF NOT EXISTS tea_rollup_delete
+        AFTER DELETE ON tea_log BEGIN
+            UPDATE tea_daily_counts SET count = count - 1
+            WHERE day =
+                unixepoch(old.logged_at, 'unixepoch', 'localtime') / 86400;
+            UPDATE tea_hourly_counts SET count = count - 1
+            WHERE hour_of_week =
+                strftime('%w', old.logged_at, 'unixepoch', 'localtime') * 24
+                + strftime('%H', old.logged_at, 'unixepoch', 'localtime');
+        END;
+        CREATE TRIGGER IF NOT EXISTS tea_rollup_update
+        AFTER UPDATE OF logged_at ON tea_log BEGIN
+            UPDATE tea_daily_counts SET count = count - 1
+            WHERE day =
+                unixepoch(old.logged_at, 'unixepoch', 'localtime') / 86400;
+            UPDATE tea_hourly_counts SET count = count - 1
+            WHERE hour_of_week =
+                strftime('%w', old.logged_at, 'unixepoch', 'localtime') * 24
+                + strftime('%H', old.logged_at, 'unixepoch', 'localtime');
+            INSERT INTO tea_daily_counts (day, count)
+            VALUES (unixepoch(new.logged_at, 'unixepoch', 'localtime') / 86400,
+                    1)
+            ON CONFLICT (day) DO UPDATE SET count = count + 1;
+            INSERT INTO tea_hourly_counts (hour_of_week, count)
+            VALUES (strftime('%w', new.logged_at, 'unixepoch', 'localtime') * 24
+                    + strftime('%H', new.logged_at, 'unixepoch', 'localtime'),
+                    1)
+            ON CONFLICT (hour_of_week) DO UPDATE SET count = count + 1;
+        END;
+    )");
+    if (!rollups_exist) {
+      execute_sql(R"(
+          INSERT INTO tea_daily_counts (day, count)
+          SELECT unixepoch(logged_at, 'unixepoch', 'localtime') / 86400 AS day,
+                 count(*)
+          FROM tea_log GROUP BY day;
+          INSERT INTO tea_hourly_counts (hour_of_week, count)
+          SELECT strftime('%w', logged_at, 'unixepoch', 'localtime') * 24
+                 + strftime('%H', logged_at, 'unixepoch', 'localtime')
+                     AS hour_of_week,
+                 count(*)
+          FROM tea_log GROUP BY hour_of_week;
+      )");
+    }
+    execute_sql("COMMIT;");
+  } catch (const std::exception&) {
+    sqlite3_exec(db.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+    throw;
+  }
+}
+
+/// @brief reads the catalogue of teas and their log counts into memory,
+/// replacing what was there. Needed after other connections or bulk SQL
+/// have written to the log.
+void TeaDatabase::reload_catalogue() {
+  tea_ids.clear();
+  catalogue.clear();
+
+  sqlite3_stmt* stmt =
+      prepare_statement("SELECT id, name, log_count FROM teas;");
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const int id = sqlite3_column_int(stmt, 0);
+    const auto log_count = static_cast<size_t>(sqlite3_column_int64(stmt, 2));
+    std::string name(column_view(stmt, 1));
+    tea_ids.emplace(name, id);
+    catalogue.emplace(id, CatalogueEntry{std::move(name), log_count});
+  }
+  finalize_statement(stmt);
+
+  // the mirror and fuzzy index can be just as stale as the catalogue, and a
+  // copy a reader is reading may predate whatever made them so
+  if (!read_only) {
+    std::unique_lock<std::shared_mutex> lock(indexes->mutex);
+    indexes->generation += 2;
+  }
+  if (is_mirror_loaded()) load_mirror();
+  if (is_fuzzy_index_loaded()) load_fuzzy_index();
+}
+
+/// @brief Brings the catalogue, mirror and fuzzy index up to date with
+/// entries another connection logged, such as those a TeaJournal folded in,
+/// without reloading them whole. Counts are read back from the teas table
+/// and entries already mirrored are skipped, so an entry may be passed more
+/// than once; one deleted since is ignored.
+/// @param entry_ids
+void TeaDatabase::load_logged_entries(const std::vector<int>& entry_ids) {
+  ScopedTimer timer("db.load_logged_entries");
+  IndexWriteScope index_write(*indexes);
+  sqlite3_stmt* stmt = prepare_statement(R"(
+      SELECT teas.id, teas.name, teas.log_count, tea_log.logged_at
+      FROM tea_log JOIN teas ON teas.id = tea_log.tea_id
+      WHERE tea_log.id = ?;
+  )");
+  for (const int id : entry_ids) {
+    sqlite3_bind_int(stmt, 1, id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      const int tea_id = sqlite3_column_int(stmt, 0);
+      std::string name(column_view(stmt, 1));
+      const auto log_count =
+          static_cast<size_t>(sqlite3_column_int64(stmt, 2));
+      const std::int64_t logged_at = sqlite3_column_int64(stmt, 3);
+      tea_ids.emplace(name, tea_id);
+      catalogue[tea_id] = CatalogueEntry{name, log_count};
+      update_fuzzy_index(tea_id);
+      update_mirror([&](LogMirror& mirror) {
+        mirror.add_tea(tea_id, name);
+        if (!mirror.contains(id, tea_id)) mirror.insert(id, tea_id, logged_at);
+      });
+    }
+    sqlite3_reset(stmt);
+  }
+  finalize_statement(stmt);
+}
+
+/// @brief Reads the whole log into the in-memory mirror, replacing what was
+/// there. The size is estimated from the per-tea counts first so a log over
+/// the budget is never read at all. The log is read without holding the lock,
+/// so searches carry on against the old mirror until the new one is in. A
+/// read-only connection sharing the writer's mirror loads it within the
+/// writer's budget, so it can be built away from the writer's thread; a
+/// copy that may have missed one of the writer's writes is read again.
+/// @return whether the mirror is now loaded; if not, searches keep going to
+/// SQLite
+bool TeaDatabase::load_mirror() {
+  ScopedTimer timer("mirror.load");
+  for (int attempt = 1;; ++attempt) {
+    const std::uint64_t generation = search_generation();
+    LogMirror mirror;
+    const bool loaded = read_mirror(mirror, indexes->mirror_budget);
+
+    std::unique_lock<std::shared_mutex> lock(indexes->mutex);
+    if (!install_allowed(generation)) {
+      if (attempt < kIndexLoadAttempts) continue;
+      return indexes->mirror_loaded;
+    }
+    const MatchEngine engine = indexes->mirror.match_engine();
+    indexes->mirror = std::move(mirror);
+    indexes->mirror.set_match_engine(engine);
+    indexes->mirror_loaded = loaded;
+    return loaded;
   }
-  return stmt;
 }
 
+/// @brief reads the whole log into a mirror, unless it would take more
+/// than the budget
+/// @param mirror empty on entry, and left empty if the log is not read
+/// @param budget
+/// @return whether the mirror holds the log
+bool TeaDatabase::read_mirror(LogMirror& mirror, size_t budget) {
+  if (budget == 0) return false;
+
+  // asked of the database rather than the catalogue, which a read-only
+  // connection does not keep
+  sqlite3_stmt* stmt = prepare_statement(
+      "SELECT coalesce(sum(log_count), 0), count(*),"
+      " coalesce(sum(length(CAST(name AS BLOB))), 0) FROM teas;");
+  size_t entries = 0;
+  size_t teas = 0;
+  size_t name_bytes = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    entries = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+    teas = static_cast<size_t>(sqlite3_column_int64(stmt, 1));
+    name_bytes = static_cast<size_t>(sqlite3_column_int64(stmt, 2));
+  }
+  finalize_statement(stmt);
+  if (LogMirror::estimate_memory(entries, teas, name_bytes) > budget) {
+    return false;
+  }
+
+  stmt = prepare_statement(
+      "SELECT l.id, t.id, t.name, l.logged_at"
+      " FROM teas t JOIN tea_log l ON l.tea_id = t.id"
+      " ORDER BY t.name, l.id;");
+  try {
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      const int tea_id = sqlite3_column_int(stmt, 1);
+      mirror.add_tea(tea_id, column_view(stmt, 2));
+      mirror.append(sqlite3_column_int(stmt, 0), tea_id,
+                    sqlite3_column_int64(stmt, 3));
+    }
+    if (rc != SQLITE_DONE) {
+      throw std::runtime_error("SQL query failed: " +
+                               std::string(sqlite3_errmsg(db.get())));
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Loading the log mirror failed: " << e.what() << std::endl;
+    finalize_statement(stmt);
+    mirror.clear();
+    return false;
+  }
+  finalize_statement(stmt);
+
+  if (mirror.memory_usage() > budget) {
+    mirror.clear();
+    return false;
+  }
+  return true;
+}
+
+/// @brief applies a write to the mirror, if loaded. A mirror that grows
+/// past its budget or fails to update is dropped, falling back to SQLite.
+/// @param update
+void TeaDatabase::update_mirror(
+    const std::function<void(LogMirror&)>& update) {
+  std::unique_lock<std::shared_mutex> lock(indexes->mutex);
+  if (!indexes->mirror_loaded) return;
+  try {
+    update(indexes->mirror);
+  } catch (const std::exception& e) {
+    std::cerr << "Log mirror update failed: " << e.what() << std::endl;
+    drop_mirror();
+    return;
+  }
+  if (indexes->mirror.memory_usage() > indexes->mirror_budget) drop_mirror();
+}
+
+/// @brief empties the mirror; called with the lock held
+void TeaDatabase::drop_mirror() {
+  indexes->mirror.clear();
+  indexes->mirror_loaded = false;
+}
+
+/// @return whether searches are answered from the mirror
+bool TeaDatabase::is_mirror_loaded() const {
+  std::shared_lock<std::shared_mutex> lock(indexes->mutex);
+  return indexes->mirror_loaded;
+}
+
+/// @brief picks how the mirror scans names
+/// @param engine
+void TeaDatabase::set_match_engine(MatchEngine engine) {
+  std::unique_lock<std::shared_mutex> lock(indexes->mutex);
+  indexes->mirror.set_match_engine(engine);
+}
+
+/// @brief Has this read-only connection search the writer's in-memory
+/// indexes instead of its own, which a read-only connection never loads.
+/// ConnectionPool does this for every reader it opens.
+/// @param writer
+void TeaDatabase::share_search_indexes(const TeaDatabase& writer) {
+  indexes = writer.indexes;
+}
+
+/// @brief Indexes the names of every tea that has been logged for
+/// find_similar_teas, replacing what was indexed before. The names are read
+/// without holding the lock; on a read-only connection sharing the writer's
+/// index, a copy that may have missed one of the writer's writes, or already
+/// hold one the writer is about to apply, is read again, and given up on if
+/// the writer keeps writing.
+/// @return whether the index is loaded
+bool TeaDatabase::load_fuzzy_index() {
+  ScopedTimer timer("fuzzy.load");
+  for (int attempt = 1;; ++attempt) {
+    const std::uint64_t generation = search_generation();
+    FuzzyNameIndex fuzzy_index;
+    sqlite3_stmt* stmt =
+        prepare_statement("SELECT id, name FROM teas WHERE log_count > 0;");
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      fuzzy_index.add(sqlite3_column_int(stmt, 0), column_view(stmt, 1));
+    }
+    finalize_statement(stmt);
+    if (rc != SQLITE_DONE) {
+      throw std::runtime_error("SQL query failed: " +
+                               std::string(sqlite3_errmsg(db.get())));
+    }
+
+    std::unique_lock<std::shared_mutex> lock(indexes->mutex);
+    if (!install_allowed(generation)) {
+      if (attempt < kIndexLoadAttempts) continue;
+      return indexes->fuzzy_loaded;
+    }
+    indexes->fuzzy_index = std::move(fuzzy_index);
+    indexes->fuzzy_loaded = true;
+    return true;
+  }
+}
+
+/// @brief the search indexes' generation, see SearchIndexes. A read-only
+/// connection waits out a write in flight first, as a copy it read during
+/// the write could not be installed.
+/// @return the generation
+std::uint64_t TeaDatabase::search_generation() const {
+  while (true) {
+    {
+      std::shared_lock<std::shared_mutex> lock(indexes->mutex);
+      if (!read_only || indexes->generation % 2 == 0) {
+        return indexes->generation;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+/// @brief Decides, with the lock held, whether a copy of the log read since
+/// the generation was taken may replace the search indexes. The writer's
+/// own copies always may, and moving the generation on turns away any copy a
+/// reader took before them. A reader's copy may only if no write was in
+/// flight when it started and none has been since.
+/// @param generation the generation before the copy was read
+/// @return whether to install the copy
+bool TeaDatabase::install_allowed(std::uint64_t generation) {
+  if (!read_only) {
+    indexes->generation += 2;
+    return true;
+  }
+  return generation % 2 == 0 && indexes->generation == generation;
+}
+
+/// @return whether find_similar_teas can answer from the fuzzy index
+bool TeaDatabase::is_fuzzy_index_loaded() const {
+  std::shared_lock<std::shared_mutex> lock(indexes->mutex);
+  return indexes->fuzzy_loaded;
+}
+
+/// @brief keeps a loaded fuzzy index holding exactly the teas with entries
+/// after this connection changed a tea's count
+/// @param tea_id
+void TeaDatabase::update_fuzzy_index(int tea_id) {
+  std::unique_lock<std::shared_mutex> lock(indexes->mutex);
+  if (!indexes->fuzzy_loaded) return;
+  auto entry = catalogue.find(tea_id);
+  if (entry != catalogue.end() && entry->second.log_count > 0) {
+    indexes->fuzzy_index.add(tea_id, entry->second.tea_name);
+  } else {
+    indexes->fuzzy_index.remove(tea_id);
+  }
+}
+
+/// @brief finds the catalogue id of a name, asking the database if another
+/// connection may have added it
+/// @param tea_name
+/// @return the id, or nothing if the tea was never logged
+std::optional<int> TeaDatabase::lookup_tea_id(const std::string& tea_name) {
+  auto known = tea_ids.find(tea_name);
+  if (known != tea_ids.end()) return known->second;
+
+  sqlite3_stmt* stmt =
+      prepare_statement("SELECT id, log_count FROM teas WHERE name = ?;");
+  sqlite3_bind_text(stmt, 1, tea_name.c_str(), -1, SQLITE_STATIC);
+  std::optional<int> id;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    id = sqlite3_column_int(stmt, 0);
+    tea_ids.emplace(tea_name, *id);
+    catalogue.emplace(*id, CatalogueEntry{tea_name,
+                                          static_cast<size_t>(
+                                              sqlite3_column_int64(stmt, 1))});
+  }
+  finalize_statement(stmt);
+  return id;
+}
+
+/// @brief finds the catalogue id of a name, adding the tea if it is new.
+/// Names already seen are answered from memory without touching SQLite.
+/// @param tea_name
+/// @return the id
+int TeaDatabase::intern_tea(const std::string& tea_name) {
+  std::optional<int> id = lookup_tea_id(tea_name);
+  if (id) return *id;
+
+  sqlite3_stmt* stmt = prepare_statement("INSERT INTO teas (name) VALUES (?);");
+  sqlite3_bind_text(stmt, 1, tea_name.c_str(), -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    std::string error_msg =
+        "Failed to add tea: " + std::string(sqlite3_errmsg(db.get()));
+    finalize_statement(stmt);
+    throw std::runtime_error(error_msg);
+  }
+  finalize_statement(stmt);
+
+  id = last_insert_id();
+  tea_ids.emplace(tea_name, *id);
+  catalogue.emplace(*id, CatalogueEntry{tea_name, 0});
+  return *id;
+}
+
+/// @brief number of times a tea has been logged, answered from memory. A
+/// read-only connection keeps no catalogue and asks the database instead.
+/// @param tea_name
+/// @return the count, 0 for teas never logged
+size_t TeaDatabase::tea_log_count(const std::string& tea_name) {
+  if (read_only) {
+    sqlite3_stmt* stmt =
+        prepare_statement("SELECT log_count FROM teas WHERE name = ?;");
+    sqlite3_bind_text(stmt, 1, tea_name.c_str(), -1, SQLITE_STATIC);
+    size_t count = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      count = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+    }
+    finalize_statement(stmt);
+    return count;
+  }
+
+  auto known = tea_ids.find(tea_name);
+  if (known == tea_ids.end()) return 0;
+  return catalogue.at(known->second).log_count;
+}
+
+/// @brief every tea that has been logged with its count, answered from
+/// memory, or from the database on a read-only connection
+/// @return counts ordered by name
+std::vector<TeaCount> TeaDatabase::tea_counts() {
+  std::vector<TeaCount> counts;
+  if (read_only) {
+    sqlite3_stmt* stmt = prepare_statement(
+        "SELECT name, log_count FROM teas WHERE log_count > 0 "
+        "ORDER BY name;");
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      counts.push_back(
+          {std::string(column_view(stmt, 0)),
+           static_cast<size_t>(sqlite3_column_int64(stmt, 1))});
+    }
+    finalize_statement(stmt);
+    return counts;
+  }
+
+  counts.reserve(catalogue.size());
+  for (const auto& [id, entry] : catalogue) {
+    if (entry.log_count > 0) {
+      counts.push_back({entry.tea_name, entry.log_count});
+    }
+  }
+  std::sort(counts.begin(), counts.end(),
+            [](const TeaCount& a, const TeaCount& b) {
+              return a.tea_name < b.tea_name;
+            });
+  return counts;
+}
+
+/// @brief checks the schema for a table
+/// @param table_name
+/// @return true if the table exists
+bool TeaDatabase::table_exists(const std::string& table_name) {
+  sqlite3_stmt* stmt = prepare_statement(
+      "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;");
+  sqlite3_bind_text(stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
+  bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+  finalize_statement(stmt);
+  return exists;
+}
+
+/// @brief checks the schema for a column
+/// @param table_name
+/// @param column_name
+/// @return true if the table has the column
+bool TeaDatabase::column_exists(const std::string& table_name,
+                                const std::string& column_name) {
+  sqlite3_stmt* stmt = prepare_statement(
+      "SELECT 1 FROM pragma_table_info(?) WHERE name = ?;");
+  sqlite3_bind_text(stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, column_name.c_str(), -1, SQLITE_STATIC);
+  bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+  finalize_statement(stmt);
+  return exists;
+}
+
+/// @brief interrupts any query running on this connection. Safe to call from
+/// another thread; the interrupted query throws from execute_query.
+void TeaDatabase::interrupt() { sqlite3_interrupt(db.get()); }
+
+/// @brief checkpoints the WAL, see SQLiteDB::checkpoint
+/// @param mode
+/// @return false if the checkpoint could not complete
+bool TeaDatabase::checkpoint(int mode) { return db.checkpoint(mode); }
+
+/// @brief gets a prepared statement for the SQL from the statement cache
+/// @param sql
+/// @return statement, to be handed back with finalize_statement
+sqlite3_stmt* TeaDatabase::prepare_statement(const std::string& sql) {
+  ScopedTimer timer("db.prepare_statement");
+  return statements.acquire(sql);
+}
+
+/// @brief hands a statement back to the cache, resetting it for the next use
+/// @param stmt
 void TeaDatabase::finalize_statement(sqlite3_stmt* stmt) {
-  if (stmt) {
-    sqlite3_finalize(stmt);
+  statements.release(stmt);
+}
+
+const StatementCache& TeaDatabase::statement_cache() const {
+  return statements;
+}
+
+/// @brief binds text parameters to a statement in order
+/// @param stmt
+/// @param params
+static void bind_params(sqlite3_stmt* stmt,
+                        const std::vector<std::string>& params) {
+  for (size_t i = 0; i < params.size(); ++i) {
+    sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_STATIC);
   }
 }
 
+/// @brief copies a row into a new entry at the end of the list, building
+/// each string once from the column text
+/// @param entries
+/// @param row
+static void append_entry(std::vector<TeaLogEntry>& entries,
+                         const TeaLogRow& row) {
+  entries.emplace_back();
+  TeaLogEntry& entry = entries.back();
+  entry.id = row.id;
+  entry.tea_name.assign(row.tea_name);
+  entry.logged_at = row.logged_at;
+}
+
 /// @brief executes SQL against the databse - parameter binding.
 /// @param sql
 /// @param params
 /// @return results
 std::vector<TeaLogEntry> TeaDatabase::execute_query(
     const std::string& sql, const std::vector<std::string>& params) {
-  std::vector<TeaLogEntry> results;
   sqlite3_stmt* stmt = prepare_statement(sql);
+  bind_params(stmt, params);
+  return collect_entries(stmt);
+}
 
-  for (size_t i = 0; i < params.size(); ++i) {
-    sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_STATIC);
+/// @brief executes an (id, tea_name, logged_at) query and passes
+/// each row to the visitor as views of the column text, so callers that
+/// keep only part of a row or build their own representation pay for no
+/// intermediate strings
+/// @param sql
+/// @param params
+/// @param visit
+void TeaDatabase::for_each_entry(const std::string& sql,
+                                 const std::vector<std::string>& params,
+                                 const EntryVisitor& visit) {
+  sqlite3_stmt* stmt = prepare_statement(sql);
+  bind_params(stmt, params);
+  visit_entries(stmt, visit);
+}
+
+/// @brief steps a bound (id, tea_name, logged_at) query to the end
+/// and hands the statement back
+/// @param stmt
+/// @return results
+std::vector<TeaLogEntry> TeaDatabase::collect_entries(sqlite3_stmt* stmt) {
+  std::vector<TeaLogEntry> results;
+  visit_entries(stmt, [&results](const TeaLogRow& row) {
+    append_entry(results, row);
+  });
+  return results;
+}
+
+/// @brief steps a bound (id, tea_name, logged_at) query to the
+/// end, visiting each row, and hands the statement back. The statement is
+/// also handed back if the visitor throws.
+/// @param stmt
+/// @param visit
+void TeaDatabase::visit_entries(sqlite3_stmt* stmt, const EntryVisitor& visit) {
+  ScopedTimer timer("db.step_rows");
+  int rc;
+  std::uint64_t rows = 0;
+  try {
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      visit(TeaLogRow{sqlite3_column_int(stmt, 0), column_view(stmt, 1),
+                      sqlite3_column_int64(stmt, 2)});
+      ++rows;
+    }
+  } catch (...) {
+    Instrumentation::instance().count("db.rows_returned", rows);
+    finalize_statement(stmt);
+    throw;
   }
+  Instrumentation::instance().count("db.rows_returned", rows);
 
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    results.emplace_back(
-        sqlite3_column_int(stmt, 0),
-        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)) ?: "",
-        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)) ?: "",
-        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)) ?: "");
+  if (rc != SQLITE_DONE) {
+    std::string error_msg =
+        "SQL query failed: " + std::string(sqlite3_errmsg(db.get()));
+    finalize_statement(stmt);
+    throw std::runtime_error(error_msg);
   }
 
   finalize_statement(stmt);
-  return results;
 }
 
 /// @brief executes the SQL against the database - non parameter binding. It is
@@ -93,74 +1030,589 @@ void TeaDatabase::execute_sql(const std::string& sql) {
 /// @param tea_name
 /// @return if the function fails return false, otherwise true
 bool TeaDatabase::log_tea(const std::string& tea_name) {
-  const std::string sql = "INSERT INTO tea_database (tea_name) VALUES (?);";
+  ScopedTimer timer("db.log_tea");
+  IndexWriteScope index_write(*indexes);
+  int tea_id;
+  try {
+    tea_id = intern_tea(tea_name);
+  } catch (const std::exception& e) {
+    std::cerr << "Log failed: " << e.what() << std::endl;
+    return false;
+  }
+
+  const std::string sql =
+      "INSERT INTO tea_log (tea_id) VALUES (?) RETURNING id, logged_at;";
   sqlite3_stmt* stmt = prepare_statement(sql);
-  sqlite3_bind_text(stmt, 1, tea_name.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 1, tea_id);
 
-  bool success = sqlite3_step(stmt) == SQLITE_DONE;
-  if (!success) {
+  bool success = sqlite3_step(stmt) == SQLITE_ROW;
+  const int id = sqlite3_column_int(stmt, 0);
+  const std::int64_t logged_at = sqlite3_column_int64(stmt, 1);
+  success = success && sqlite3_step(stmt) == SQLITE_DONE;
+  if (success) {
+    ++catalogue[tea_id].log_count;
+    update_fuzzy_index(tea_id);
+    update_mirror([&](LogMirror& mirror) {
+      mirror.add_tea(tea_id, tea_name);
+      mirror.insert(id, tea_id, logged_at);
+    });
+  } else {
     std::cerr << "Log failed: " << sqlite3_errmsg(db.get()) << std::endl;
   }
   finalize_statement(stmt);
   return success;
 }
 
+/// @brief Logs several teas in one transaction, so the batch costs a single
+/// commit instead of one per tea. An insert that fails is reported and the
+/// rest of the batch carries on; if the transaction itself is lost every
+/// item is reported as failed.
+/// @param tea_names
+/// @return the outcome of each insert, in the same order as the names
+std::vector<LogResult> TeaDatabase::log_teas(
+    const std::vector<std::string>& tea_names) {
+  return log_teas_at(tea_names, nullptr);
+}
+
+/// @brief Logs several teas in one transaction like log_teas, each at a
+/// time of its own rather than now, for entries recorded elsewhere first.
+/// Called inside an open transaction, the batch only commits with it.
+/// @param tea_names
+/// @param logged_at unix time of each entry, in the same order as the names
+/// @return the outcome of each insert, in the same order as the names
+std::vector<LogResult> TeaDatabase::log_teas(
+    const std::vector<std::string>& tea_names,
+    const std::vector<std::int64_t>& logged_at) {
+  if (logged_at.size() != tea_names.size()) {
+    throw std::runtime_error("log_teas: one time is needed per tea");
+  }
+  return log_teas_at(tea_names, logged_at.data());
+}
+
+/// @brief inserts the batch under a savepoint
+/// @param tea_names
+/// @param logged_at a time per name, or null to log them all now
+std::vector<LogResult> TeaDatabase::log_teas_at(
+    const std::vector<std::string>& tea_names, const std::int64_t* logged_at) {
+  ScopedTimer timer("db.log_teas");
+  std::vector<LogResult> results(tea_names.size());
+  if (tea_names.empty()) return results;
+  IndexWriteScope index_write(*indexes);
+
+  execute_sql("SAVEPOINT log_teas;");
+
+  const std::string sql =
+      logged_at ? "INSERT INTO tea_log (tea_id, logged_at) VALUES (?, ?) "
+                  "RETURNING id, logged_at;"
+                : "INSERT INTO tea_log (tea_id) VALUES (?) "
+                  "RETURNING id, logged_at;";
+  sqlite3_stmt* stmt = prepare_statement(sql);
+  bool transaction_lost = false;
+  for (size_t i = 0; i < tea_names.size(); ++i) {
+    int tea_id;
+    try {
+      tea_id = intern_tea(tea_names[i]);
+    } catch (const std::exception& e) {
+      std::cerr << "Log failed: " << e.what() << std::endl;
+      if (sqlite3_get_autocommit(db.get())) {
+        transaction_lost = true;
+        break;
+      }
+      continue;
+    }
+
+    sqlite3_bind_int(stmt, 1, tea_id);
+    if (logged_at) sqlite3_bind_int64(stmt, 2, logged_at[i]);
+    bool inserted = sqlite3_step(stmt) == SQLITE_ROW;
+    const int id = sqlite3_column_int(stmt, 0);
+    const std::int64_t inserted_at = sqlite3_column_int64(stmt, 1);
+    if (inserted && sqlite3_step(stmt) == SQLITE_DONE) {
+      results[i] = {true, id};
+      ++catalogue[tea_id].log_count;
+      update_fuzzy_index(tea_id);
+      update_mirror([&](LogMirror& mirror) {
+        mirror.add_tea(tea_id, tea_names[i]);
+        mirror.insert(id, tea_id, inserted_at);
+      });
+    } else {
+      std::cerr << "Log failed: " << sqlite3_errmsg(db.get()) << std::endl;
+      // errors such as SQLITE_FULL roll back the whole transaction
+      if (sqlite3_get_autocommit(db.get())) {
+        transaction_lost = true;
+        break;
+      }
+    }
+    sqlite3_reset(stmt);
+  }
+  finalize_statement(stmt);
+
+  if (!transaction_lost &&
+      sqlite3_exec(db.get(), "RELEASE log_teas;", nullptr, nullptr,
+                   nullptr) == SQLITE_OK) {
+    return results;
+  }
+
+  std::cerr << "Log batch failed: " << sqlite3_errmsg(db.get()) << std::endl;
+  if (!sqlite3_get_autocommit(db.get())) {
+    sqlite3_exec(db.get(), "ROLLBACK TO log_teas; RELEASE log_teas;", nullptr,
+                 nullptr, nullptr);
+  }
+  for (auto& result : results) {
+    result = LogResult();
+  }
+  // teas added, counted and mirrored inside the lost transaction are gone
+  // again
+  reload_catalogue();
+  return results;
+}
+
 /// @brief Deletes a tea
 /// @param tea_name
 /// @return if the function fails return false, otherwise true
 bool TeaDatabase::delete_tea(const std::string& tea_name) {
-  const std::string sql = "DELETE FROM tea_database WHERE tea_name = ?;";
+  std::vector<int> deleted_ids;
+  return delete_tea(tea_name, deleted_ids);
+}
+
+/// @brief Deletes a tea and reports which entries were removed
+/// @param tea_name
+/// @param deleted_ids receives the ids of the deleted entries
+/// @return if the function fails return false, otherwise true
+bool TeaDatabase::delete_tea(const std::string& tea_name,
+                             std::vector<int>& deleted_ids) {
+  ScopedTimer timer("db.delete_tea");
+  IndexWriteScope index_write(*indexes);
+  // the catalogue entry stays, so the name keeps its id if logged again
+  std::optional<int> tea_id;
+  try {
+    tea_id = lookup_tea_id(tea_name);
+  } catch (const std::exception& e) {
+    std::cerr << "Delete failed: " << e.what() << std::endl;
+    return false;
+  }
+  if (!tea_id) return true;
+
+  const std::string sql = "DELETE FROM tea_log WHERE tea_id = ? RETURNING id;";
   sqlite3_stmt* stmt = prepare_statement(sql);
-  sqlite3_bind_text(stmt, 1, tea_name.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 1, *tea_id);
 
-  bool success = sqlite3_step(stmt) == SQLITE_DONE;
-  if (!success) {
+  const size_t first_deleted = deleted_ids.size();
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    deleted_ids.push_back(sqlite3_column_int(stmt, 0));
+  }
+
+  bool success = rc == SQLITE_DONE;
+  if (success) {
+    CatalogueEntry& entry = catalogue[*tea_id];
+    entry.log_count -=
+        std::min(entry.log_count, deleted_ids.size() - first_deleted);
+    update_fuzzy_index(*tea_id);
+    update_mirror([&](LogMirror& mirror) { mirror.erase_tea(*tea_id); });
+  } else {
     std::cerr << "Delete failed: " << sqlite3_errmsg(db.get()) << std::endl;
   }
   finalize_statement(stmt);
   return success;
 }
 
-/// @brief updates the database for editing
+/// @brief updates the database for editing. The lookup, the new name and
+/// the update are made under one savepoint, so a failed rename leaves no
+/// tea behind.
 /// @param tea_id
 /// @param new_name
-void TeaDatabase::update_tea_name(int tea_id, const std::string& new_name) {
+/// @return false if the entry does not exist or the update fails,
+/// otherwise true
+bool TeaDatabase::update_tea_name(int tea_id, const std::string& new_name) {
+  ScopedTimer timer("db.update_tea_name");
+  IndexWriteScope index_write(*indexes);
+  bool interned = false;
   try {
-    const std::string sql = "UPDATE tea_database SET tea_name = ? WHERE id = ?";
-    sqlite3_stmt* stmt = prepare_statement(sql);
-    sqlite3_bind_text(stmt, 1, new_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, tea_id);
+    execute_sql("SAVEPOINT update_tea_name;");
+    sqlite3_stmt* stmt =
+        prepare_statement("SELECT tea_id FROM tea_log WHERE id = ?;");
+    sqlite3_bind_int(stmt, 1, tea_id);
+    std::optional<int> old_tea_id;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      old_tea_id = sqlite3_column_int(stmt, 0);
+    }
+    finalize_statement(stmt);
+    if (!old_tea_id) {
+      throw std::runtime_error("no entry " + std::to_string(tea_id));
+    }
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+    interned = !lookup_tea_id(new_name);
+    const int new_tea_id = intern_tea(new_name);
+
+    stmt = prepare_statement("UPDATE tea_log SET tea_id = ? WHERE id = ?;");
+    sqlite3_bind_int(stmt, 1, new_tea_id);
+    sqlite3_bind_int(stmt, 2, tea_id);
+    bool success = sqlite3_step(stmt) == SQLITE_DONE &&
+                   sqlite3_changes(db.get()) == 1;
+    finalize_statement(stmt);
+    if (!success) {
       throw std::runtime_error("Failed to update tea name");
     }
-    finalize_statement(stmt);
+    execute_sql("RELEASE update_tea_name;");
+
+    if (*old_tea_id != new_tea_id) {
+      auto old_entry = catalogue.find(*old_tea_id);
+      if (old_entry != catalogue.end() && old_entry->second.log_count > 0) {
+        --old_entry->second.log_count;
+      }
+      ++catalogue[new_tea_id].log_count;
+      update_fuzzy_index(*old_tea_id);
+      update_fuzzy_index(new_tea_id);
+      update_mirror([&](LogMirror& mirror) {
+        mirror.add_tea(new_tea_id, new_name);
+        if (!mirror.move(tea_id, *old_tea_id, new_tea_id)) {
+          throw std::runtime_error("entry " + std::to_string(tea_id) +
+                                   " is not mirrored");
+        }
+      });
+    }
+    return true;
   } catch (const std::exception& e) {
     std::cerr << "Error updating tea name: " << e.what() << std::endl;
+    if (!sqlite3_get_autocommit(db.get())) {
+      sqlite3_exec(db.get(), "ROLLBACK TO update_tea_name;"
+                   " RELEASE update_tea_name;", nullptr, nullptr, nullptr);
+    }
+    // a tea added for the new name went with the savepoint
+    if (interned) reload_catalogue();
+    return false;
   }
 }
 
-/// @brief  finds tea entries based on the parameter
+/// @brief id of the most recently logged entry on this connection
+int TeaDatabase::last_insert_id() const {
+  return static_cast<int>(sqlite3_last_insert_rowid(db.get()));
+}
+
+/// @brief looks up a single entry by id
+/// @param tea_id
+/// @return the entry, or nothing if no entry has that id
+std::optional<TeaLogEntry> TeaDatabase::find_tea_entry(int tea_id) {
+  const std::string sql =
+      "SELECT id, tea_name, logged_at FROM tea_database"
+      " WHERE id = ?;";
+  sqlite3_stmt* stmt = prepare_statement(sql);
+  sqlite3_bind_int(stmt, 1, tea_id);
+
+  std::optional<TeaLogEntry> entry;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    entry.emplace(
+        sqlite3_column_int(stmt, 0),
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)) ?: "",
+        sqlite3_column_int64(stmt, 2));
+  }
+  finalize_statement(stmt);
+  return entry;
+}
+
+/// @brief counts the characters in a UTF-8 string
+/// @param text
+/// @return number of code points
+static size_t utf8_length(const std::string& text) {
+  size_t length = 0;
+  for (unsigned char c : text) {
+    if ((c & 0xC0) != 0x80) ++length;
+  }
+  return length;
+}
+
+/// @brief quotes the term as a single FTS5 string so that operators and
+/// punctuation in tea names are matched literally
+/// @param term
+/// @return the quoted term
+static std::string quote_fts_term(const std::string& term) {
+  std::string quoted = "\"";
+  for (char c : term) {
+    if (c == '"') quoted += '"';
+    quoted += c;
+  }
+  quoted += '"';
+  return quoted;
+}
+
+/// @brief  finds tea entries based on the parameter. Terms of three or more
+/// characters are answered by the trigram index and ranked by relevance,
+/// shorter terms (which trigrams cannot match) fall back to LIKE. While the
+/// mirror is loaded it answers instead, ordering matches by name, unless
+/// the search engine is set to SQLite. Only names containing the term
+/// match; find_similar_entries is there for callers wanting to offer
+/// something when nothing does.
 /// @param search_Term
 /// @return entries
 std::vector<TeaLogEntry> TeaDatabase::find_tea_entries(
     const std::string& search_Term) {
   std::vector<TeaLogEntry> entries;
-  std::string sql =
-      "SELECT id, tea_name, local_time, utc_time FROM tea_database";
+  find_tea_entries(search_Term, [&entries](const TeaLogRow& row) {
+    append_entry(entries, row);
+  });
+  return entries;
+}
+
+/// @brief finds tea entries as above, passing each one to the visitor
+/// instead of building entries
+/// @param search_Term
+/// @param visit
+void TeaDatabase::find_tea_entries(const std::string& search_Term,
+                                   const EntryVisitor& visit) {
+  ScopedTimer timer("db.find_tea_entries");
+  if (search_engine == SearchEngine::Mirror) {
+    std::shared_lock<std::shared_mutex> lock(indexes->mutex);
+    if (indexes->mirror_loaded) {
+      const LogMirror& mirror = indexes->mirror;
+      Instrumentation::instance().count("mirror.rows_scanned", mirror.size());
+      if (search_Term.empty()) {
+        mirror.for_each(visit);
+      } else {
+        mirror.for_each_match(search_Term, visit);
+      }
+      return;
+    }
+  }
+
+  std::string sql;
   std::vector<std::string> params;
 
-  if (!search_Term.empty()) {
-    sql += " WHERE tea_name LIKE ?";
+  if (search_Term.empty()) {
+    sql =
+        "SELECT id, tea_name, logged_at FROM tea_database"
+        " ORDER BY tea_name ASC";
+  } else if (has_search_index && utf8_length(search_Term) >= 3) {
+    sql =
+        "SELECT l.id, t.name, l.logged_at"
+        " FROM tea_name_search JOIN teas t ON t.id = tea_name_search.rowid"
+        " JOIN tea_log l ON l.tea_id = t.id"
+        " WHERE tea_name_search MATCH ?"
+        " ORDER BY tea_name_search.rank, t.name ASC, l.id";
+    params.push_back(quote_fts_term(search_Term));
+  } else {
+    sql =
+        "SELECT id, tea_name, logged_at FROM tea_database"
+        " WHERE tea_name LIKE ? ORDER BY tea_name ASC";
     params.push_back("%" + search_Term + "%");
   }
 
-  sql += " ORDER BY tea_name ASC";
+  for_each_entry(sql, params, visit);
+}
 
-  auto query_results = execute_query(sql, params);
-  for (const auto& row : query_results) {
-    TeaLogEntry entry(row.id, row.tea_name, row.local_time, row.utc_time);
-    entries.push_back(entry);
+/// @brief visits the entries of the teas most similar to the term, best
+/// match first and each tea's entries in log order, so a typo such as
+/// "oolng" still finds Oolong
+/// @param search_term
+/// @param visit
+void TeaDatabase::find_similar_entries(const std::string& search_term,
+                                       const EntryVisitor& visit) {
+  for (const SimilarTea& tea : find_similar_teas(search_term)) {
+    sqlite3_stmt* stmt = prepare_statement(
+        "SELECT l.id, t.name, l.logged_at"
+        " FROM teas t JOIN tea_log l ON l.tea_id = t.id"
+        " WHERE t.id = ? ORDER BY l.id;");
+    sqlite3_bind_int(stmt, 1, tea.tea_id);
+    visit_entries(stmt, visit);
   }
-  return entries;
-}
\ No newline at end of file
+}
+
+/// @brief Ranks the logged teas whose names contain something within a few
+/// typos of the term, loading the fuzzy index first if it is not loaded.
+/// Writes through other connections than the one keeping the index show up
+/// after reload_catalogue, as in the catalogue.
+/// @param search_term
+/// @param limit maximum number of teas returned
+/// @return teas, closest first
+std::vector<SimilarTea> TeaDatabase::find_similar_teas(
+    const std::string& search_term, size_t limit) {
+  ScopedTimer timer("db.find_similar_teas");
+  std::vector<FuzzyMatch> matches;
+  bool loaded;
+  {
+    std::shared_lock<std::shared_mutex> lock(indexes->mutex);
+    loaded = indexes->fuzzy_loaded;
+    if (loaded) matches = indexes->fuzzy_index.search(search_term, limit);
+  }
+  if (!loaded && load_fuzzy_index()) {
+    std::shared_lock<std::shared_mutex> lock(indexes->mutex);
+    matches = indexes->fuzzy_index.search(search_term, limit);
+  }
+
+  std::vector<SimilarTea> teas;
+  for (const FuzzyMatch& match : matches) {
+    sqlite3_stmt* stmt =
+        prepare_statement("SELECT name FROM teas WHERE id = ?;");
+    sqlite3_bind_int(stmt, 1, match.tea_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      teas.push_back({match.tea_id, std::string(column_view(stmt, 0)),
+                      match.distance});
+    }
+    finalize_statement(stmt);
+  }
+  return teas;
+}
+
+/// @brief counts every entry in the log from the per-tea counts
+/// @return number of entries
+size_t TeaDatabase::count_tea_entries() {
+  sqlite3_stmt* stmt =
+      prepare_statement("SELECT coalesce(sum(log_count), 0) FROM teas;");
+  size_t count = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    count = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+  }
+  finalize_statement(stmt);
+  return count;
+}
+
+/// @brief counts the entries ordered before a key, which is the position the
+/// key has in the (tea_name, id) ordered log. Without a lower bound this
+/// sums the counts of the teas named before the key and only counts rows of
+/// the key's own tea. Giving a known key before it limits the count to the
+/// range between the two.
+/// @param key
+/// @param after only count entries after this key
+/// @return number of entries before the key (and after the lower bound)
+size_t TeaDatabase::count_tea_entries_before(
+    const TeaLogKey& key, const std::optional<TeaLogKey>& after) {
+  ScopedTimer timer("db.count_tea_entries_before");
+  sqlite3_stmt* stmt;
+  int next_param = 1;
+  if (after) {
+    stmt = prepare_statement(
+        "SELECT count(*) FROM tea_database"
+        " WHERE (tea_name, id) > (?, ?) AND (tea_name, id) < (?, ?);");
+    sqlite3_bind_text(stmt, next_param++, after->tea_name.c_str(), -1,
+                      SQLITE_STATIC);
+    sqlite3_bind_int(stmt, next_param++, after->id);
+  } else {
+    stmt = prepare_statement(
+        "SELECT (SELECT coalesce(sum(log_count), 0) FROM teas WHERE name < ?1)"
+        " + (SELECT count(*) FROM tea_log WHERE id < ?2"
+        " AND tea_id = (SELECT id FROM teas WHERE name = ?1));");
+  }
+  sqlite3_bind_text(stmt, next_param++, key.tea_name.c_str(), -1,
+                    SQLITE_STATIC);
+  sqlite3_bind_int(stmt, next_param++, key.id);
+
+  size_t count = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    count = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+  }
+  finalize_statement(stmt);
+  return count;
+}
+
+/// @brief reads a run of entries in (tea_name, id) order. Starting from a
+/// known key walks the index from that key instead of skipping rows from the
+/// start of the log, so the offset only needs to cover the gap after it.
+/// @param after key to start after, or nothing to start at the first entry
+/// @param offset entries to skip after the key
+/// @param limit maximum number of entries returned
+/// @return entries
+std::vector<TeaLogEntry> TeaDatabase::find_tea_entries_after(
+    const std::optional<TeaLogKey>& after, size_t offset, size_t limit) {
+  ScopedTimer timer("db.find_tea_entries_after");
+  sqlite3_stmt* stmt;
+  int next_param = 1;
+  if (after) {
+    stmt = prepare_statement(
+        "SELECT id, tea_name, logged_at FROM tea_database"
+        " WHERE (tea_name, id) > (?, ?)"
+        " ORDER BY tea_name, id LIMIT ? OFFSET ?;");
+    sqlite3_bind_text(stmt, next_param++, after->tea_name.c_str(), -1,
+                      SQLITE_STATIC);
+    sqlite3_bind_int(stmt, next_param++, after->id);
+  } else {
+    stmt = prepare_statement(
+        "SELECT id, tea_name, logged_at FROM tea_database"
+        " ORDER BY tea_name, id LIMIT ? OFFSET ?;");
+  }
+  sqlite3_bind_int64(stmt, next_param++, static_cast<sqlite3_int64>(limit));
+  sqlite3_bind_int64(stmt, next_param++, static_cast<sqlite3_int64>(offset));
+
+  return collect_entries(stmt);
+}
+
+/// @brief Reads the page of entries after a cursor in (tea_name, id) order.
+/// The rest of the cursor's own tea comes from the index on (tea_id, id) and
+/// the teas after it from the unique index on name, so a page costs the same
+/// wherever it starts, unlike skipping rows with an offset. CROSS JOIN keeps
+/// the planner walking teas in name order; joining from tea_log instead
+/// would sort the whole log before returning the first row.
+/// @param cursor where the page starts
+/// @param limit maximum number of entries on the page
+/// @return the entries, and a cursor for the next page unless this was the
+/// last one
+TeaLogPage TeaDatabase::find_tea_page(const TeaLogCursor& cursor,
+                                      size_t limit) {
+  ScopedTimer timer("db.find_tea_page");
+  TeaLogPage page;
+  // one extra row tells whether there is a next page
+  const sqlite3_int64 wanted = static_cast<sqlite3_int64>(limit) + 1;
+  sqlite3_stmt* stmt;
+  if (const std::optional<TeaLogKey>& after = cursor.after()) {
+    stmt = prepare_statement(
+        "SELECT l.id, t.name, l.logged_at"
+        " FROM teas t CROSS JOIN tea_log l ON l.tea_id = t.id"
+        " WHERE t.name = ? AND l.id > ? ORDER BY l.id LIMIT ?;");
+    sqlite3_bind_text(stmt, 1, after->tea_name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, after->id);
+    sqlite3_bind_int64(stmt, 3, wanted);
+    page.entries = collect_entries(stmt);
+
+    if (page.entries.size() < static_cast<size_t>(wanted)) {
+      stmt = prepare_statement(
+          "SELECT l.id, t.name, l.logged_at"
+          " FROM teas t CROSS JOIN tea_log l ON l.tea_id = t.id"
+          " WHERE t.name > ? ORDER BY t.name, l.id LIMIT ?;");
+      sqlite3_bind_text(stmt, 1, after->tea_name.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 2, wanted - page.entries.size());
+      visit_entries(stmt, [&page](const TeaLogRow& row) {
+        append_entry(page.entries, row);
+      });
+    }
+  } else {
+    stmt = prepare_statement(
+        "SELECT l.id, t.name, l.logged_at"
+        " FROM teas t CROSS JOIN tea_log l ON l.tea_id = t.id"
+        " ORDER BY t.name, l.id LIMIT ?;");
+    sqlite3_bind_int64(stmt, 1, wanted);
+    page.entries = collect_entries(stmt);
+  }
+
+  if (page.entries.size() > limit) {
+    page.entries.resize(limit);
+    const TeaLogEntry& last = page.entries.back();
+    page.next = TeaLogCursor(TeaLogKey{last.tea_name, last.id});
+  }
+  return page;
+}
+
+/// @brief reads the entries logged in a time range, oldest first, walking
+/// the index on logged_at so only the range itself is read
+/// @param from first second of the range, inclusive
+/// @param to end of the range, exclusive
+/// @return entries
+std::vector<TeaLogEntry> TeaDatabase::find_entries_in_range(std::int64_t from,
+                                                            std::int64_t to) {
+  sqlite3_stmt* stmt = prepare_statement(
+      "SELECT id, tea_name, logged_at FROM tea_database"
+      " WHERE logged_at >= ? AND logged_at < ?"
+      " ORDER BY logged_at, id;");
+  sqlite3_bind_int64(stmt, 1, from);
+  sqlite3_bind_int64(stmt, 2, to);
+  return collect_entries(stmt);
+}
+
+/// @brief reads the most recently logged entries, newest first, from the end
+/// of the index on logged_at
+/// @param limit maximum number of entries returned
+/// @return entries
+std::vector<TeaLogEntry> TeaDatabase::find_latest_entries(size_t limit) {
+  sqlite3_stmt* stmt = prepare_statement(
+      "SELECT id, tea_name, logged_at FROM tea_database"
+      " ORDER BY logged_at DESC, id DESC LIMIT ?;");
+  sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(limit));
+  return collect_entries(stmt);
+}
@@ -3,38 +3,242 @@
 
 #include <sqlite3.h>
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "../models/tea.hpp"
+#include "../utility/instrumentation.hpp"
+#include "fuzzy_name_index.hpp"
+#include "log_mirror.hpp"
+#include "statement_cache.hpp"
+
+/// @brief file name of the database in the data directory
+inline constexpr const char* kDefaultDatabasePath = "tea_database.db";
+
+/// @brief stamped into PRAGMA user_version once the schema is current;
+/// raise it whenever create_schema gains a step
+inline constexpr int kSchemaVersion = 1;
+
+std::string default_database_path();
+
+/// @brief Settings applied to a connection when it is opened. The defaults
+/// use WAL so readers never block the writer, and synchronous=NORMAL so a
+/// commit only appends to the WAL instead of waiting on a full fsync.
+struct ConnectionOptions {
+  enum class Synchronous { Off, Normal, Full };
+
+  bool read_only = false;
+  // open in SQLite's multi-thread mode, skipping the per-connection mutex;
+  // the connection must then only be used by one thread at a time
+  bool no_mutex = false;
+  std::string journal_mode = "WAL";
+  Synchronous synchronous = Synchronous::Normal;
+  sqlite3_int64 mmap_size = 256LL * 1024 * 1024;
+  int cache_size_kib = 16 * 1024;
+  bool temp_store_memory = true;
+  int busy_timeout_ms = 5000;
+
+  // checkpoint policy: fold the WAL back into the database every this many
+  // pages, and truncate the WAL file down to the size limit afterwards
+  int wal_autocheckpoint_pages = 1000;
+  sqlite3_int64 journal_size_limit = 64LL * 1024 * 1024;
+
+  // memory the in-memory log mirror may use; a log that needs more is
+  // searched in SQLite instead, and 0 turns the mirror off
+  size_t mirror_budget_bytes = 64 * 1024 * 1024;
+
+  // time every statement through sqlite3_trace_v2 and report those taking
+  // at least this many microseconds; negative turns tracing off
+  std::int64_t slow_statement_us = slow_statement_threshold_from_environment();
+};
 
 /// @brief Handles the database connection
 class SQLiteDB {
  public:
-  SQLiteDB(const std::string& db_path);
+  SQLiteDB(const std::string& db_path,
+           const ConnectionOptions& options = ConnectionOptions());
   ~SQLiteDB();
   sqlite3* get() const;
+  bool checkpoint(int mode = SQLITE_CHECKPOINT_PASSIVE);
 
  private:
   sqlite3* db = nullptr;
+  sqlite3_int64 slow_statement_ns = 0;
+
+  void configure(const ConnectionOptions& options);
+};
+
+/// @brief outcome of one insert of a batch
+struct LogResult {
+  bool success = false;
+  int id = 0;
+};
+
+/// @brief how often one tea has been logged
+struct TeaCount {
+  std::string tea_name;
+  size_t count;
 };
 
-/// @brief Provides methods for interacting with the sqlite database
+/// @brief a tea whose name is close to a search term
+struct SimilarTea {
+  int tea_id;
+  std::string tea_name;
+  int distance;
+};
+
+/// @brief what answers find_tea_entries: SQLite, or the in-memory mirror
+/// whenever it is loaded
+enum class SearchEngine { Sqlite, Mirror };
+
+/// @brief The in-memory copy of the log and the fuzzy name index a writer
+/// connection keeps for searching. The read-only connections of its pool
+/// share them, so searches running on other threads are answered from them
+/// too. The writer applies its writes under the exclusive lock, and
+/// searches hold the shared lock while they scan. generation moves on with
+/// every write the writer makes and is odd while one is in flight, so a
+/// copy read from another connection can tell whether it may have missed
+/// one.
+struct SearchIndexes {
+  mutable std::shared_mutex mutex;
+  LogMirror mirror;
+  size_t mirror_budget = 0;
+  bool mirror_loaded = false;
+  FuzzyNameIndex fuzzy_index;
+  bool fuzzy_loaded = false;
+  std::uint64_t generation = 0;
+};
+
+/// @brief called once per row of a query; the row's views point into the
+/// statement and are only valid during the call. A visitor of a mirrored
+/// search runs under the mirror's shared lock, so it must not write through
+/// the database that called it.
+using EntryVisitor = std::function<void(const TeaLogRow& row)>;
+
+/// @brief Provides methods for interacting with the sqlite database. Each
+/// distinct tea is stored once in the teas catalogue and log entries refer
+/// to it by id; tea_database is a view joining the two back into
+/// (id, tea_name, logged_at) rows. The catalogue, with per-tea log counts,
+/// is also held in memory and kept up to date by this connection's writes.
+/// Writes made through other connections show up after reload_catalogue,
+/// or for entries another connection logged, after load_logged_entries.
+/// Once load_mirror has been called, the log is also mirrored in memory
+/// within the connection's budget, and searches are answered from the
+/// mirror while it is loaded, on this connection and on any read-only one
+/// sharing its search indexes. Teas with names similar to a term, for
+/// searches that find nothing, come from a trigram index over the distinct
+/// names that is built on first use and kept up to date like the catalogue.
+///
+/// Threading: a TeaDatabase is not thread-safe. It may move between threads
+/// but only one thread may use it at a time, and its catalogue and statement
+/// cache belong to it alone; the search indexes are locked as they may be
+/// shared. interrupt() is the exception and may be called from any thread.
+/// Code sharing a database file across threads leases connections from a
+/// ConnectionPool, which serializes writers and gives each concurrent reader
+/// its own read-only connection; under WAL a reader sees the last commit
+/// made before its statement started.
 class TeaDatabase {
  public:
-  TeaDatabase(const std::string& db_path);
+  TeaDatabase(const std::string& db_path,
+              const ConnectionOptions& options = ConnectionOptions());
   void execute_sql(const std::string& sql);
   bool log_tea(const std::string& tea_name);
-  void update_tea_name(int tea_id, const std::string& new_name);
+  std::vector<LogResult> log_teas(const std::vector<std::string>& tea_names);
+  std::vector<LogResult> log_teas(const std::vector<std::string>& tea_names,
+                                  const std::vector<std::int64_t>& logged_at);
+  bool update_tea_name(int tea_id, const std::string& new_name);
   bool delete_tea(const std::string& tea_name);
+  bool delete_tea(const std::string& tea_name, std::vector<int>& deleted_ids);
+  int last_insert_id() const;
   void finalize_statement(sqlite3_stmt* stmt);
   sqlite3_stmt* prepare_statement(const std::string& sql);
 
   std::vector<TeaLogEntry> execute_query(
       const std::string& sql, const std::vector<std::string>& params);
+  void for_each_entry(const std::string& sql,
+                      const std::vector<std::string>& params,
+                      const EntryVisitor& visit);
   std::vector<TeaLogEntry> find_tea_entries(const std::string& search_Term);
+  void find_tea_entries(const std::string& search_Term,
+                        const EntryVisitor& visit);
+  std::optional<TeaLogEntry> find_tea_entry(int tea_id);
+  void find_similar_entries(const std::string& search_term,
+                            const EntryVisitor& visit);
+  std::vector<SimilarTea> find_similar_teas(const std::string& search_term,
+                                            size_t limit = 10);
+  bool load_fuzzy_index();
+  bool is_fuzzy_index_loaded() const;
+
+  size_t count_tea_entries();
+  size_t count_tea_entries_before(
+      const TeaLogKey& key,
+      const std::optional<TeaLogKey>& after = std::nullopt);
+  std::vector<TeaLogEntry> find_tea_entries_after(
+      const std::optional<TeaLogKey>& after, size_t offset, size_t limit);
+  TeaLogPage find_tea_page(const TeaLogCursor& cursor, size_t limit);
+  std::vector<TeaLogEntry> find_entries_in_range(std::int64_t from,
+                                                 std::int64_t to);
+  std::vector<TeaLogEntry> find_latest_entries(size_t limit);
+
+  size_t tea_log_count(const std::string& tea_name);
+  std::vector<TeaCount> tea_counts();
+  void reload_catalogue();
+  void load_logged_entries(const std::vector<int>& entry_ids);
+
+  bool load_mirror();
+  bool is_mirror_loaded() const;
+  void set_search_engine(SearchEngine engine) { search_engine = engine; }
+  void set_match_engine(MatchEngine engine);
+  void share_search_indexes(const TeaDatabase& writer);
+
+  const StatementCache& statement_cache() const;
+  void interrupt();
+  bool checkpoint(int mode = SQLITE_CHECKPOINT_PASSIVE);
 
  private:
   SQLiteDB db;
+  StatementCache statements;
+  bool read_only = false;
+  bool has_search_index = false;
+
+  struct CatalogueEntry {
+    std::string tea_name;
+    size_t log_count = 0;
+  };
+  std::unordered_map<std::string, int> tea_ids;
+  std::unordered_map<int, CatalogueEntry> catalogue;
+
+  std::shared_ptr<SearchIndexes> indexes;
+  SearchEngine search_engine = SearchEngine::Mirror;
+
+
+  int schema_version();
+  void create_schema();
+  void create_search_index();
+  void create_statistics_rollups();
+  void migrate_text_timestamps();
+  void migrate_to_catalogue();
+  int intern_tea(const std::string& tea_name);
+  std::vector<LogResult> log_teas_at(const std::vector<std::string>& tea_names,
+                                     const std::int64_t* logged_at);
+  std::optional<int> lookup_tea_id(const std::string& tea_name);
+  bool table_exists(const std::string& table_name);
+  bool column_exists(const std::string& table_name,
+                     const std::string& column_name);
+  std::vector<TeaLogEntry> collect_entries(sqlite3_stmt* stmt);
+  void visit_entries(sqlite3_stmt* stmt, const EntryVisitor& visit);
+  void update_fuzzy_index(int tea_id);
+  std::uint64_t search_generation() const;
+  bool install_allowed(std::uint64_t generation);
+  bool read_mirror(LogMirror& mirror, size_t budget);
+  void update_mirror(const std::function<void(LogMirror&)>& update);
+  void drop_mirror();
 };
 
 #endif
\ No newline at end of file
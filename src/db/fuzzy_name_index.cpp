@@ -0,0 +1,256 @@
+#include "fuzzy_name_index.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <tuple>
+
+// terms up to this long are scored without allocating
+static constexpr int kShortTerm = 64;
+
+/// @brief ASCII lower case, matching how the substring search folds case
+static std::string fold(std::string_view text) {
+  std::string folded(text);
+  for (char& c : folded) {
+    if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+  }
+  return folded;
+}
+
+/// @brief which bytes occur in a string, each folded onto one of 64 bits
+static std::uint64_t letter_mask(std::string_view text) {
+  std::uint64_t mask = 0;
+  for (char c : text) mask |= std::uint64_t{1} << (c & 63);
+  return mask;
+}
+
+/// @brief which pairs of adjacent bytes occur in a string, hashed onto 64
+/// bits
+static std::uint64_t pair_mask(std::string_view text) {
+  std::uint64_t mask = 0;
+  for (size_t i = 0; i + 1 < text.size(); ++i) {
+    const unsigned pair = static_cast<unsigned char>(text[i]) * 31u +
+                          static_cast<unsigned char>(text[i + 1]);
+    mask |= std::uint64_t{1} << (pair & 63);
+  }
+  return mask;
+}
+
+/// @brief the distinct trigrams of a folded string, each packed into the
+/// low three bytes of an integer
+static std::vector<std::uint32_t> distinct_grams(std::string_view folded) {
+  std::vector<std::uint32_t> grams;
+  if (folded.size() < 3) return grams;
+  grams.reserve(folded.size() - 2);
+  for (size_t i = 0; i + 3 <= folded.size(); ++i) {
+    grams.push_back(static_cast<std::uint32_t>(
+        static_cast<unsigned char>(folded[i]) << 16 |
+        static_cast<unsigned char>(folded[i + 1]) << 8 |
+        static_cast<unsigned char>(folded[i + 2])));
+  }
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+  return grams;
+}
+
+void FuzzyNameIndex::clear() {
+  m_slots.clear();
+  m_slotOf.clear();
+  m_postings.clear();
+  m_deadSlots = 0;
+}
+
+/// @brief indexes a name under its catalogue id; a tea already indexed is
+/// left as it is
+/// @param tea_id
+/// @param name
+void FuzzyNameIndex::add(int tea_id, std::string_view name) {
+  const auto slot = static_cast<std::uint32_t>(m_slots.size());
+  if (!m_slotOf.emplace(tea_id, slot).second) return;
+
+  std::string folded = fold(name);
+  const std::uint64_t letters = letter_mask(folded);
+  const std::uint64_t pairs = pair_mask(folded);
+  m_slots.push_back(Slot{tea_id, std::move(folded), letters, pairs});
+  for (std::uint32_t gram : distinct_grams(m_slots.back().folded)) {
+    m_postings[gram].push_back(slot);
+  }
+}
+
+/// @brief takes a tea out of the index, if it is in it
+/// @param tea_id
+void FuzzyNameIndex::remove(int tea_id) {
+  auto found = m_slotOf.find(tea_id);
+  if (found == m_slotOf.end()) return;
+
+  // the postings still point at the slot, so it is only marked dead here
+  Slot& slot = m_slots[found->second];
+  slot.tea_id = -1;
+  slot.folded.clear();
+  m_slotOf.erase(found);
+  ++m_deadSlots;
+  if (m_deadSlots > 1024 && m_deadSlots > m_slotOf.size()) compact();
+}
+
+/// @brief Ranks the names containing something within a few edits of the
+/// term: fewest edits first, then most trigrams shared, then shortest name.
+/// @param term
+/// @param limit maximum number of matches returned
+/// @return matches, best first; terms under three characters match nothing
+std::vector<FuzzyMatch> FuzzyNameIndex::search(std::string_view term,
+                                               size_t limit) const {
+  const std::string folded = fold(term);
+  const std::vector<std::uint32_t> grams = distinct_grams(folded);
+  if (grams.empty() || limit == 0) return {};
+
+  std::vector<std::uint32_t> shared(m_slots.size());
+  std::vector<std::uint32_t> touched;
+  for (std::uint32_t gram : grams) {
+    auto posting = m_postings.find(gram);
+    if (posting == m_postings.end()) continue;
+    for (std::uint32_t slot : posting->second) {
+      if (shared[slot]++ == 0) touched.push_back(slot);
+    }
+  }
+
+  // candidates by the number of trigrams they share with the term
+  const int term_grams = static_cast<int>(grams.size());
+  std::vector<std::vector<std::uint32_t>> by_shared(term_grams + 1);
+  for (std::uint32_t slot : touched) by_shared[shared[slot]].push_back(slot);
+
+  struct Scored {
+    FuzzyMatch match;
+    size_t length;
+  };
+  auto better = [](const Scored& a, const Scored& b) {
+    return std::make_tuple(a.match.distance, -a.match.shared_grams, a.length,
+                           a.match.tea_id) <
+           std::make_tuple(b.match.distance, -b.match.shared_grams, b.length,
+                           b.match.tea_id);
+  };
+  // the best matches so far as a heap with the worst of them on top
+  std::vector<Scored> kept;
+  int bound = max_distance(folded.size());
+  const std::uint64_t term_letters = letter_mask(folded);
+  const std::uint64_t term_pairs = pair_mask(folded);
+  auto score = [&](std::uint32_t slot) {
+    const Slot& candidate = m_slots[slot];
+    if (candidate.tea_id < 0) return;
+    // once the heap is full a name must at least tie with its worst match
+    const int within = kept.size() < limit
+                           ? bound
+                           : std::min(bound, kept.front().match.distance);
+    // every letter of the term the name lacks takes an edit, and an edit
+    // breaks at most two of the term's letter pairs
+    const std::bitset<64> missing(term_letters & ~candidate.letters);
+    if (static_cast<int>(missing.count()) > within) return;
+    const std::bitset<64> missing_pairs(term_pairs & ~candidate.pairs);
+    if (static_cast<int>(missing_pairs.count()) > 2 * within) return;
+    const int distance = bounded_distance(folded, candidate.folded, within);
+    if (distance > within) return;
+
+    const Scored scored{
+        {candidate.tea_id, distance, static_cast<int>(shared[slot])},
+        candidate.folded.size()};
+    if (kept.size() == limit) {
+      if (!better(scored, kept.front())) return;
+      std::pop_heap(kept.begin(), kept.end(), better);
+      kept.pop_back();
+    }
+    kept.push_back(scored);
+    std::push_heap(kept.begin(), kept.end(), better);
+  };
+
+  // Score the names sharing the most trigrams first. Each edit breaks at
+  // most three of the term's trigrams, so a name sharing fewer is at least
+  // correspondingly many edits away; once the matches kept are all closer
+  // than that, the rest cannot displace them and are never scored.
+  for (int shared_grams = term_grams; shared_grams >= 0; --shared_grams) {
+    const int fewest_edits = (term_grams - shared_grams + 2) / 3;
+    if (fewest_edits > bound) break;
+    if (kept.size() == limit) {
+      // a later name ties on edits but shares fewer trigrams, so it only
+      // gets in by being strictly closer than the worst match kept
+      const int worst = kept.front().match.distance;
+      if (fewest_edits >= worst) break;
+      bound = worst - 1;
+    }
+
+    if (shared_grams > 0) {
+      for (std::uint32_t slot : by_shared[shared_grams]) score(slot);
+    } else {
+      // short terms can be misspelled past every trigram they have
+      for (std::uint32_t slot = 0; slot < m_slots.size(); ++slot) {
+        if (shared[slot] == 0) score(slot);
+      }
+    }
+  }
+
+  std::sort_heap(kept.begin(), kept.end(), better);
+  std::vector<FuzzyMatch> matches;
+  matches.reserve(kept.size());
+  for (const Scored& scored : kept) matches.push_back(scored.match);
+  return matches;
+}
+
+/// @brief how many edits a term of this length may be from a name; short
+/// terms get fewer so they do not match nearly everything
+/// @param term_length in bytes
+int FuzzyNameIndex::max_distance(size_t term_length) {
+  if (term_length < 3) return 0;
+  if (term_length <= 5) return 1;
+  return 2;
+}
+
+/// @brief Edit distance between the term and the part of the text it
+/// matches best, so a term found anywhere in the text costs nothing. Only
+/// rows of the dynamic programming table still within the bound are
+/// computed, and anything over the bound is reported as bound + 1.
+/// @param term
+/// @param text
+/// @param bound
+/// @return the distance, or bound + 1 if it is over the bound
+int FuzzyNameIndex::bounded_distance(std::string_view term,
+                                     std::string_view text, int bound) {
+  const int m = static_cast<int>(term.size());
+
+  // column of the table for the text read so far: row i holds the edits
+  // needed to match the first i term characters ending at this point
+  int short_column[kShortTerm + 1];
+  std::vector<int> long_column;
+  int* column = short_column;
+  if (m > kShortTerm) {
+    long_column.resize(m + 1);
+    column = long_column.data();
+  }
+  for (int i = 0; i <= m; ++i) column[i] = i;
+
+  // rows after last are over the bound and stay so until it moves down
+  int last = std::min(bound, m);
+  int best = last == m ? m : bound + 1;
+  for (char c : text) {
+    int diagonal = 0;
+    const int end = std::min(last + 1, m);
+    for (int i = 1; i <= end; ++i) {
+      const int left = column[i];
+      column[i] = std::min({diagonal + (term[i - 1] != c ? 1 : 0), left + 1,
+                            column[i - 1] + 1});
+      diagonal = left;
+    }
+    last = end;
+    while (last > 0 && column[last] > bound) --last;
+    if (last == m) {
+      best = std::min(best, column[m]);
+      if (best == 0) break;
+    }
+  }
+  return best;
+}
+
+/// @brief rebuilds the postings without the dead slots
+void FuzzyNameIndex::compact() {
+  std::vector<Slot> slots = std::move(m_slots);
+  clear();
+  for (Slot& slot : slots) {
+    if (slot.tea_id >= 0) add(slot.tea_id, slot.folded);
+  }
+}
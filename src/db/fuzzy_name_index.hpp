@@ -0,0 +1,60 @@
+#ifndef FUZZY_NAME_INDEX_HPP
+#define FUZZY_NAME_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// @brief a tea name close to a search term
+struct FuzzyMatch {
+  int tea_id;
+  int distance;      // edits between the term and the closest part of the name
+  int shared_grams;  // trigrams the term and the name have in common
+};
+
+/// @brief Finds tea names that contain a search term give or take a few
+/// typos. Every distinct name is split into its trigrams, folded to ASCII
+/// lower case, and an inverted index maps each trigram to the names holding
+/// it. A search visits names in order of how many trigrams they share with
+/// the term, skips those whose letters rule them out, and scores the rest
+/// with an edit distance to the best matching part of the name that gives
+/// up once it exceeds the bound. Names sharing too few trigrams to beat the
+/// matches already found are never looked at. Names are keyed by catalogue
+/// id so TeaDatabase can keep the index in step with its writes.
+class FuzzyNameIndex {
+ public:
+  void clear();
+  size_t size() const { return m_slotOf.size(); }
+  bool contains(int tea_id) const { return m_slotOf.count(tea_id) != 0; }
+
+  void add(int tea_id, std::string_view name);
+  void remove(int tea_id);
+
+  std::vector<FuzzyMatch> search(std::string_view term,
+                                 size_t limit = 10) const;
+
+  static int max_distance(size_t term_length);
+  static int bounded_distance(std::string_view term, std::string_view text,
+                              int bound);
+
+ private:
+  struct Slot {
+    int tea_id;  // -1 once removed
+    std::string folded;
+    std::uint64_t letters;  // bytes present in the name, folded mod 64
+    std::uint64_t pairs;    // adjacent byte pairs present, hashed mod 64
+  };
+
+  void compact();
+
+  // names in the order they were added; removed names leave a dead slot
+  // behind until enough have piled up to rebuild the postings
+  std::vector<Slot> m_slots;
+  std::unordered_map<int, std::uint32_t> m_slotOf;  // by catalogue id
+  std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> m_postings;
+  size_t m_deadSlots = 0;
+};
+
+#endif
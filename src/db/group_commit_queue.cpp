@@ -0,0 +1,114 @@
+#include "group_commit_queue.hpp"
+
+#include "../utility/instrumentation.hpp"
+
+/// @brief starts the commit thread, which leases the pool's writer for each
+/// batch
+/// @param pool must outlive the queue
+/// @param options
+GroupCommitQueue::GroupCommitQueue(ConnectionPool& pool,
+                                   const GroupCommitOptions& options)
+    : m_pool(pool), m_options(options) {
+  if (m_options.max_batch == 0) m_options.max_batch = 1;
+  m_thread = std::thread(&GroupCommitQueue::run, this);
+}
+
+/// @brief commits everything still queued before closing
+GroupCommitQueue::~GroupCommitQueue() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+/// @brief queues a tea to be logged with the next batch
+/// @param tea_name
+/// @return resolves with the outcome once the batch has been committed
+std::future<LogResult> GroupCommitQueue::enqueue(std::string tea_name) {
+  std::future<LogResult> result;
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // the first tea starts the batch's delay, and a full batch ends it
+    const bool first = m_pending.empty();
+    if (first) m_oldestPending = std::chrono::steady_clock::now();
+    m_pending.push_back(PendingLog{std::move(tea_name), {}});
+    result = m_pending.back().result.get_future();
+    ++m_enqueuedCount;
+    wake = first || m_pending.size() >= m_options.max_batch;
+  }
+  if (wake) m_wake.notify_all();
+  return result;
+}
+
+/// @brief commits everything queued so far without waiting for the batch to
+/// fill, and blocks until it is written. Must not be called while holding
+/// the pool's writer lease, which the commit thread waits for.
+void GroupCommitQueue::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const std::uint64_t target = m_enqueuedCount;
+  m_flushRequested = true;
+  m_wake.notify_all();
+  m_committed.wait(lock, [this, target] { return m_committedCount >= target; });
+}
+
+void GroupCommitQueue::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_wake.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+    if (m_pending.empty()) return;
+
+    // let the batch grow until it is full, old enough or a flush is asked for
+    m_wake.wait_until(lock, m_oldestPending + m_options.max_delay, [this] {
+      return m_stopping || m_flushRequested ||
+             m_pending.size() >= m_options.max_batch;
+    });
+
+    std::vector<PendingLog> batch;
+    if (m_pending.size() > m_options.max_batch) {
+      batch.assign(std::make_move_iterator(m_pending.begin()),
+                   std::make_move_iterator(m_pending.begin() +
+                                           m_options.max_batch));
+      m_pending.erase(m_pending.begin(),
+                      m_pending.begin() + m_options.max_batch);
+      m_oldestPending = std::chrono::steady_clock::now();
+    } else {
+      batch.swap(m_pending);
+      m_flushRequested = false;
+    }
+    lock.unlock();
+
+    commit(batch);
+
+    lock.lock();
+    m_committedCount += batch.size();
+    m_committed.notify_all();
+  }
+}
+
+/// @brief writes one batch in a transaction on the pool's writer and hands
+/// every caller the outcome for its own tea
+/// @param batch
+void GroupCommitQueue::commit(std::vector<PendingLog>& batch) {
+  ScopedTimer timer("group_commit.batch");
+  std::vector<std::string> tea_names;
+  tea_names.reserve(batch.size());
+  for (const auto& pending : batch) {
+    tea_names.push_back(pending.tea_name);
+  }
+
+  std::vector<LogResult> results;
+  try {
+    ConnectionPool::Lease writer = m_pool.writer();
+    results = writer->log_teas(tea_names);
+  } catch (const std::exception&) {
+    results.clear();
+  }
+  results.resize(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    batch[i].result.set_value(results[i]);
+  }
+  Instrumentation::instance().count("group_commit.teas", batch.size());
+}
@@ -0,0 +1,66 @@
+#ifndef GROUP_COMMIT_QUEUE_HPP
+#define GROUP_COMMIT_QUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection_pool.hpp"
+#include "db_handler.hpp"
+
+/// @brief when the group commit queue writes a batch
+struct GroupCommitOptions {
+  size_t max_batch = 1024;
+  std::chrono::milliseconds max_delay = std::chrono::milliseconds(10);
+};
+
+/// @brief Collects teas logged from any thread and writes them on a
+/// background thread, coalescing everything pending into one transaction. A
+/// batch is committed once it reaches max_batch teas or its oldest tea has
+/// waited max_delay. Each batch is written through a lease on the pool's
+/// writer, so it waits for any other writer lease to end and keeps the
+/// writer's catalogue, mirror and fuzzy index current.
+class GroupCommitQueue {
+ public:
+  explicit GroupCommitQueue(
+      ConnectionPool& pool,
+      const GroupCommitOptions& options = GroupCommitOptions());
+  ~GroupCommitQueue();
+
+  GroupCommitQueue(const GroupCommitQueue&) = delete;
+  GroupCommitQueue& operator=(const GroupCommitQueue&) = delete;
+
+  std::future<LogResult> enqueue(std::string tea_name);
+  void flush();
+
+ private:
+  struct PendingLog {
+    std::string tea_name;
+    std::promise<LogResult> result;
+  };
+
+  void run();
+  void commit(std::vector<PendingLog>& batch);
+
+  ConnectionPool& m_pool;
+  GroupCommitOptions m_options;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_committed;
+  bool m_stopping = false;
+  bool m_flushRequested = false;
+  std::vector<PendingLog> m_pending;
+  std::chrono::steady_clock::time_point m_oldestPending;
+  std::uint64_t m_enqueuedCount = 0;
+  std::uint64_t m_committedCount = 0;
+
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "log_mirror.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+void LogMirror::clear() {
+  m_arena.clear();
+  m_arena.shrink_to_fit();
+  m_names = std::vector<Name>();
+  m_nameIndex.clear();
+  m_ids = std::vector<int>();
+  m_entryNames = std::vector<std::uint32_t>();
+  m_loggedAt = std::vector<std::int64_t>();
+}
+
+/// @brief bytes held by the mirror, counting reserved capacity
+size_t LogMirror::memory_usage() const {
+  return m_arena.capacity() + m_names.capacity() * sizeof(Name) +
+         m_nameIndex.size() * (sizeof(int) + sizeof(std::uint32_t) +
+                               2 * sizeof(void*)) +
+         m_ids.capacity() * sizeof(int) +
+         m_entryNames.capacity() * sizeof(std::uint32_t) +
+         m_loggedAt.capacity() * sizeof(std::int64_t);
+}
+
+/// @brief bytes a mirror of the given size would need, used to decide
+/// whether to load it at all
+/// @param entries
+/// @param names distinct names
+/// @param name_bytes total length of the distinct names
+size_t LogMirror::estimate_memory(size_t entries, size_t names,
+                                  size_t name_bytes) {
+  return name_bytes +
+         names * (sizeof(Name) + sizeof(int) + sizeof(std::uint32_t) +
+                  2 * sizeof(void*)) +
+         entries * (sizeof(int) + sizeof(std::uint32_t) + sizeof(std::int64_t));
+}
+
+/// @brief makes a catalogue tea known to the mirror, storing its name in the
+/// arena. Teas already known are left as they are.
+/// @param tea_id
+/// @param name
+void LogMirror::add_tea(int tea_id, std::string_view name) {
+  if (m_nameIndex.count(tea_id)) return;
+  if (m_arena.size() + name.size() > UINT32_MAX) {
+    throw std::length_error("Tea name arena is full");
+  }
+
+  m_names.push_back({static_cast<std::uint32_t>(m_arena.size()),
+                     static_cast<std::uint32_t>(name.size())});
+  m_arena.append(name);
+  m_nameIndex.emplace(tea_id,
+                      static_cast<std::uint32_t>(m_names.size() - 1));
+}
+
+/// @brief adds an entry that sorts after every entry already held, as when
+/// loading in order
+/// @param id
+/// @param tea_id
+/// @param logged_at
+void LogMirror::append(int id, int tea_id, std::int64_t logged_at) {
+  insert_at(m_ids.size(), id, m_nameIndex.at(tea_id), logged_at);
+}
+
+/// @brief adds an entry at its place in (tea_name, id) order
+/// @param id
+/// @param tea_id
+/// @param logged_at
+void LogMirror::insert(int id, int tea_id, std::int64_t logged_at) {
+  const std::uint32_t name_index = m_nameIndex.at(tea_id);
+  insert_at(lower_bound(name(name_index), id), id, name_index, logged_at);
+}
+
+/// @brief whether an entry is held under the given tea
+/// @param id
+/// @param tea_id
+bool LogMirror::contains(int id, int tea_id) const {
+  auto known = m_nameIndex.find(tea_id);
+  if (known == m_nameIndex.end()) return false;
+  const size_t position = lower_bound(name(known->second), id);
+  return position < m_ids.size() && m_ids[position] == id &&
+         m_entryNames[position] == known->second;
+}
+
+/// @brief removes every entry of a tea, which are one contiguous run
+/// @param tea_id
+/// @return number of entries removed
+size_t LogMirror::erase_tea(int tea_id) {
+  auto known = m_nameIndex.find(tea_id);
+  if (known == m_nameIndex.end()) return 0;
+
+  const std::string_view tea_name = name(known->second);
+  const size_t first = lower_bound(tea_name, INT_MIN);
+  size_t last = first;
+  while (last < m_ids.size() && m_entryNames[last] == known->second) ++last;
+  erase_range(first, last);
+  return last - first;
+}
+
+/// @brief moves an entry to another tea, as when it is renamed
+/// @param id
+/// @param old_tea_id
+/// @param new_tea_id
+/// @return false if the entry was not found
+bool LogMirror::move(int id, int old_tea_id, int new_tea_id) {
+  const std::uint32_t old_index = m_nameIndex.at(old_tea_id);
+  const size_t position = lower_bound(name(old_index), id);
+  if (position >= m_ids.size() || m_ids[position] != id ||
+      m_entryNames[position] != old_index) {
+    return false;
+  }
+
+  const std::int64_t logged_at = m_loggedAt[position];
+  erase_range(position, position + 1);
+  insert(id, new_tea_id, logged_at);
+  return true;
+}
+
+/// @brief visits every entry in (tea_name, id) order
+/// @param visit
+void LogMirror::for_each(const RowVisitor& visit) const {
+  for (size_t i = 0; i < m_ids.size(); ++i) {
+    visit(TeaLogRow{m_ids[i], name(m_entryNames[i]), m_loggedAt[i]});
+  }
+}
+
+/// @brief visits the entries whose name contains the term, ignoring ASCII
+/// case as LIKE does, in (tea_name, id) order
+/// @param term
+/// @param visit
+void LogMirror::for_each_match(std::string_view term,
+                               const RowVisitor& visit) const {
+  const std::vector<bool> matches = match_names(term);
+  for (size_t i = 0; i < m_ids.size(); ++i) {
+    if (matches[m_entryNames[i]]) {
+      visit(TeaLogRow{m_ids[i], name(m_entryNames[i]), m_loggedAt[i]});
+    }
+  }
+}
+
+/// @brief ids of the entries whose name contains the term, in (tea_name, id)
+/// order
+/// @param term
+/// @return ids
+std::vector<int> LogMirror::match_ids(std::string_view term) const {
+  const std::vector<bool> matches = match_names(term);
+  std::vector<int> ids;
+  for (size_t i = 0; i < m_ids.size(); ++i) {
+    if (matches[m_entryNames[i]]) ids.push_back(m_ids[i]);
+  }
+  return ids;
+}
+
+/// @brief Flags the names containing the term. The arena is scanned as one
+/// string; an occurrence is mapped to its name through the name offsets,
+/// which increase with the name index, and the scan then skips to the next
+/// name. Occurrences spanning two names are ignored.
+/// @param term
+/// @return one flag per name index
+std::vector<bool> LogMirror::match_names(std::string_view term) const {
+  std::vector<bool> matches(m_names.size(), term.empty());
+  if (term.empty()) return matches;
+
+  const SubstringMatcher matcher(term, m_matchEngine);
+  const std::string_view arena(m_arena);
+  size_t from = 0;
+  while ((from = matcher.find(arena, from)) != std::string_view::npos) {
+    auto next = std::upper_bound(
+        m_names.begin(), m_names.end(), from,
+        [](size_t position, const Name& slot) {
+          return position < slot.offset;
+        });
+    const Name& slot = *(next - 1);
+    const size_t name_end = size_t{slot.offset} + slot.length;
+    if (from + term.size() <= name_end) {
+      matches[next - 1 - m_names.begin()] = true;
+      from = name_end;
+    } else {
+      ++from;
+    }
+  }
+  return matches;
+}
+
+std::string_view LogMirror::name(std::uint32_t name_index) const {
+  const Name& slot = m_names[name_index];
+  return std::string_view(m_arena).substr(slot.offset, slot.length);
+}
+
+/// @brief first position whose (tea_name, id) is not before the key
+size_t LogMirror::lower_bound(std::string_view tea_name, int id) const {
+  size_t low = 0;
+  size_t high = m_ids.size();
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    const int order = name(m_entryNames[middle]).compare(tea_name);
+    if (order < 0 || (order == 0 && m_ids[middle] < id)) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+void LogMirror::insert_at(size_t position, int id, std::uint32_t name_index,
+                          std::int64_t logged_at) {
+  m_ids.insert(m_ids.begin() + position, id);
+  m_entryNames.insert(m_entryNames.begin() + position, name_index);
+  m_loggedAt.insert(m_loggedAt.begin() + position, logged_at);
+}
+
+void LogMirror::erase_range(size_t first, size_t last) {
+  m_ids.erase(m_ids.begin() + first, m_ids.begin() + last);
+  m_entryNames.erase(m_entryNames.begin() + first,
+                     m_entryNames.begin() + last);
+  m_loggedAt.erase(m_loggedAt.begin() + first, m_loggedAt.begin() + last);
+}
@@ -0,0 +1,70 @@
+#ifndef LOG_MIRROR_HPP
+#define LOG_MIRROR_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../models/tea.hpp"
+#include "../utility/substring_matcher.hpp"
+
+/// @brief A copy of the log held in memory as parallel columns sorted by
+/// (tea_name, id): entry ids, the index of each entry's name, and logged_at
+/// times. Names are stored once in a single arena. Searches scan the names
+/// once, in a single pass of a SubstringMatcher over the arena, and then
+/// the name column, without touching SQLite. Teas are keyed
+/// by their catalogue id, so writes made through TeaDatabase can be applied
+/// as they happen.
+class LogMirror {
+ public:
+  using RowVisitor = std::function<void(const TeaLogRow& row)>;
+
+  void clear();
+  size_t size() const { return m_ids.size(); }
+  size_t memory_usage() const;
+  static size_t estimate_memory(size_t entries, size_t names,
+                                size_t name_bytes);
+
+  void add_tea(int tea_id, std::string_view name);
+  void append(int id, int tea_id, std::int64_t logged_at);
+  void insert(int id, int tea_id, std::int64_t logged_at);
+  size_t erase_tea(int tea_id);
+  bool move(int id, int old_tea_id, int new_tea_id);
+  bool contains(int id, int tea_id) const;
+
+  void for_each(const RowVisitor& visit) const;
+  void for_each_match(std::string_view term, const RowVisitor& visit) const;
+  std::vector<int> match_ids(std::string_view term) const;
+
+  void set_match_engine(MatchEngine engine) { m_matchEngine = engine; }
+  MatchEngine match_engine() const { return m_matchEngine; }
+
+ private:
+  struct Name {
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+
+  std::string_view name(std::uint32_t name_index) const;
+  std::vector<bool> match_names(std::string_view term) const;
+  size_t lower_bound(std::string_view name, int id) const;
+  void insert_at(size_t position, int id, std::uint32_t name_index,
+                 std::int64_t logged_at);
+  void erase_range(size_t first, size_t last);
+
+  std::string m_arena;
+  std::vector<Name> m_names;
+  std::unordered_map<int, std::uint32_t> m_nameIndex;  // by catalogue id
+
+  // one element per entry, in (tea_name, id) order
+  std::vector<int> m_ids;
+  std::vector<std::uint32_t> m_entryNames;
+  std::vector<std::int64_t> m_loggedAt;
+
+  MatchEngine m_matchEngine = best_match_engine();
+};
+
+#endif
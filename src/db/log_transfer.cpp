@@ -0,0 +1,539 @@
+#include "log_transfer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../models/timestamp.hpp"
+
+namespace {
+
+/// @brief one tea read from an import file
+struct ImportRecord {
+  std::string tea_name;
+  std::optional<std::string> local_time;
+  std::optional<std::string> utc_time;
+};
+
+/// @brief reads one CSV record. Quoted fields may contain commas, doubled
+/// quotes and line breaks.
+/// @param buffer
+/// @param fields
+/// @return false at the end of the input
+bool read_csv_record(std::streambuf& buffer, std::vector<std::string>& fields) {
+  fields.clear();
+  std::string field;
+  bool in_quotes = false;
+  bool read_any = false;
+
+  for (int c = buffer.sbumpc(); c != EOF; c = buffer.sbumpc()) {
+    read_any = true;
+    if (in_quotes) {
+      if (c != '"') {
+        field += static_cast<char>(c);
+      } else if (buffer.sgetc() == '"') {
+        field += '"';
+        buffer.sbumpc();
+      } else {
+        in_quotes = false;
+      }
+    } else if (c == '"') {
+      in_quotes = true;
+    } else if (c == ',') {
+      fields.push_back(std::move(field));
+      field.clear();
+    } else if (c == '\n') {
+      break;
+    } else if (c == '\r') {
+      if (buffer.sgetc() == '\n') buffer.sbumpc();
+      break;
+    } else {
+      field += static_cast<char>(c);
+    }
+  }
+
+  if (!read_any) return false;
+  fields.push_back(std::move(field));
+  return true;
+}
+
+/// @brief appends a code point as UTF-8
+void append_utf8(std::string& out, unsigned long code_point) {
+  if (code_point < 0x80) {
+    out += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    out += static_cast<char>(0xC0 | (code_point >> 6));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    out += static_cast<char>(0xE0 | (code_point >> 12));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (code_point >> 18));
+    out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+/// @brief minimal reader for the flat JSON objects of a JSONL log
+class JsonLineParser {
+ public:
+  explicit JsonLineParser(const std::string& line) : m_line(line) {}
+
+  /// @brief parses {"key": value, ...}. Strings and numbers are kept as
+  /// text, null values are left out and nested values are rejected.
+  bool parse(std::unordered_map<std::string, std::string>& values) {
+    values.clear();
+    skip_space();
+    if (!consume('{')) return false;
+    skip_space();
+    if (consume('}')) return at_end();
+
+    while (true) {
+      std::string key;
+      std::string value;
+      bool is_null = false;
+      skip_space();
+      if (!parse_string(key)) return false;
+      skip_space();
+      if (!consume(':')) return false;
+      skip_space();
+      if (!parse_value(value, is_null)) return false;
+      if (!is_null) values[key] = std::move(value);
+      skip_space();
+      if (consume('}')) return at_end();
+      if (!consume(',')) return false;
+    }
+  }
+
+ private:
+  void skip_space() {
+    while (m_pos < m_line.size() &&
+           std::isspace(static_cast<unsigned char>(m_line[m_pos]))) {
+      ++m_pos;
+    }
+  }
+
+  bool consume(char expected) {
+    if (m_pos < m_line.size() && m_line[m_pos] == expected) {
+      ++m_pos;
+      return true;
+    }
+    return false;
+  }
+
+  bool at_end() {
+    skip_space();
+    return m_pos == m_line.size();
+  }
+
+  bool parse_hex4(unsigned long& value) {
+    if (m_pos + 4 > m_line.size()) return false;
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = m_line[m_pos++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool parse_string(std::string& out) {
+    if (!consume('"')) return false;
+    while (m_pos < m_line.size()) {
+      const char c = m_line[m_pos++];
+      if (c == '"') return true;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (m_pos >= m_line.size()) return false;
+      const char escaped = m_line[m_pos++];
+      switch (escaped) {
+        case '"':
+        case '\\':
+        case '/':
+          out += escaped;
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          unsigned long code_point;
+          if (!parse_hex4(code_point)) return false;
+          // surrogate pairs encode code points above the basic plane
+          if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+            unsigned long low;
+            if (!consume('\\') || !consume('u') || !parse_hex4(low) ||
+                low < 0xDC00 || low > 0xDFFF) {
+              return false;
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                         (low - 0xDC00);
+          }
+          append_utf8(out, code_point);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool parse_value(std::string& out, bool& is_null) {
+    if (m_pos >= m_line.size()) return false;
+    if (m_line[m_pos] == '"') return parse_string(out);
+    if (m_line.compare(m_pos, 4, "null") == 0) {
+      m_pos += 4;
+      is_null = true;
+      return true;
+    }
+
+    // numbers and booleans are kept as their text
+    const size_t start = m_pos;
+    while (m_pos < m_line.size() && m_line[m_pos] != ',' &&
+           m_line[m_pos] != '}' &&
+           !std::isspace(static_cast<unsigned char>(m_line[m_pos]))) {
+      if (m_line[m_pos] == '{' || m_line[m_pos] == '[') return false;
+      ++m_pos;
+    }
+    out = m_line.substr(start, m_pos - start);
+    return !out.empty();
+  }
+
+  const std::string& m_line;
+  size_t m_pos = 0;
+};
+
+/// @brief maps CSV columns to record fields
+struct CsvLayout {
+  int name = 0;
+  int local_time = -1;
+  int utc_time = -1;
+};
+
+/// @brief works out the column layout from the first record
+/// @param fields
+/// @param layout
+/// @return true if the record was a header naming the columns
+bool detect_csv_layout(const std::vector<std::string>& fields,
+                       CsvLayout& layout) {
+  auto header = std::find(fields.begin(), fields.end(), "tea_name");
+  if (header != fields.end()) {
+    layout = CsvLayout{static_cast<int>(header - fields.begin()), -1, -1};
+    for (size_t i = 0; i < fields.size(); ++i) {
+      if (fields[i] == "local_time") layout.local_time = static_cast<int>(i);
+      if (fields[i] == "utc_time") layout.utc_time = static_cast<int>(i);
+    }
+    return true;
+  }
+
+  // headerless files are either plain names or the exported column order
+  if (fields.size() >= 4) {
+    layout = CsvLayout{1, 2, 3};
+  } else {
+    layout = CsvLayout{0, fields.size() > 1 ? 1 : -1,
+                       fields.size() > 2 ? 2 : -1};
+  }
+  return false;
+}
+
+std::optional<std::string> csv_field(const std::vector<std::string>& fields,
+                                     int column) {
+  if (column < 0 || static_cast<size_t>(column) >= fields.size() ||
+      fields[column].empty()) {
+    return std::nullopt;
+  }
+  return fields[column];
+}
+
+void write_csv_field(std::ostream& output, std::string_view field) {
+  if (field.find_first_of(",\"\r\n") == std::string_view::npos) {
+    output.write(field.data(), field.size());
+    return;
+  }
+  output.put('"');
+  for (char c : field) {
+    if (c == '"') output.put('"');
+    output.put(c);
+  }
+  output.put('"');
+}
+
+void write_json_string(std::ostream& output, std::string_view text) {
+  output.put('"');
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        output << "\\\"";
+        break;
+      case '\\':
+        output << "\\\\";
+        break;
+      case '\n':
+        output << "\\n";
+        break;
+      case '\r':
+        output << "\\r";
+        break;
+      case '\t':
+        output << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[7];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                        static_cast<unsigned char>(c));
+          output << escaped;
+        } else {
+          output.put(c);
+        }
+    }
+  }
+  output.put('"');
+}
+
+}  // namespace
+
+/// @brief picks the format from a name such as "csv" or a file name ending
+/// in .csv, .jsonl or .ndjson
+/// @param name
+/// @param format set if the name is recognised
+/// @return false if the format is unknown
+bool transfer_format_from_name(const std::string& name,
+                               TransferFormat& format) {
+  std::string lower = name;
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  auto ends_with = [&lower](const std::string& suffix) {
+    return lower.size() >= suffix.size() &&
+           lower.compare(lower.size() - suffix.size(), suffix.size(),
+                         suffix) == 0;
+  };
+
+  if (lower == "csv" || ends_with(".csv")) {
+    format = TransferFormat::Csv;
+    return true;
+  }
+  if (lower == "jsonl" || ends_with(".jsonl") || ends_with(".ndjson")) {
+    format = TransferFormat::Jsonl;
+    return true;
+  }
+  return false;
+}
+
+TeaImporter::TeaImporter(TeaDatabase& database, size_t batch_size)
+    : m_database(database), m_batchSize(batch_size > 0 ? batch_size : 1) {}
+
+/// @brief imports every record of the input
+/// @param input
+/// @param format
+/// @return number of imported and rejected records
+TransferStats TeaImporter::import_log(std::istream& input,
+                                      TransferFormat format) {
+  TransferStats stats;
+  size_t in_batch = 0;
+  size_t record_number = 0;
+
+  // Rows are staged in a temporary table and moved with one statement per
+  // batch. Inserting them one by one would flush the full text index at the
+  // end of every statement, which is several times slower than the insert.
+  m_database.execute_sql(R"(
+      CREATE TEMP TABLE IF NOT EXISTS import_batch (
+          tea_name TEXT NOT NULL,
+          logged_at INTEGER
+      );
+      DELETE FROM temp.import_batch;
+      BEGIN IMMEDIATE;
+  )");
+  sqlite3_stmt* stmt = m_database.prepare_statement(
+      "INSERT INTO temp.import_batch (tea_name, logged_at) VALUES (?, ?);");
+
+  auto flush_batch = [&]() {
+    m_database.execute_sql(R"(
+        INSERT INTO teas (name)
+        SELECT DISTINCT tea_name FROM temp.import_batch WHERE true
+        ON CONFLICT (name) DO NOTHING;
+        INSERT INTO tea_log (tea_id, logged_at)
+        SELECT t.id, coalesce(b.logged_at, unixepoch())
+        FROM temp.import_batch b JOIN teas t ON t.name = b.tea_name
+        ORDER BY b.rowid;
+        DELETE FROM temp.import_batch;
+    )");
+    stats.rows += in_batch;
+    in_batch = 0;
+  };
+
+  auto insert = [&](const ImportRecord& record) {
+    ++record_number;
+    if (record.tea_name.empty()) {
+      std::cerr << "Record " << record_number << ": missing tea_name"
+                << std::endl;
+      ++stats.failed;
+      return;
+    }
+
+    // the UTC time is exact; a local time is read in this machine's zone
+    std::optional<std::int64_t> logged_at;
+    if (record.utc_time) {
+      logged_at = parse_timestamp(*record.utc_time);
+    } else if (record.local_time) {
+      logged_at = parse_local_timestamp(*record.local_time);
+    }
+    if (logged_at == kUnknownTime) {
+      std::cerr << "Record " << record_number << ": unreadable time"
+                << std::endl;
+      ++stats.failed;
+      return;
+    }
+
+    sqlite3_bind_text(stmt, 1, record.tea_name.data(),
+                      static_cast<int>(record.tea_name.size()), SQLITE_STATIC);
+    if (logged_at) {
+      sqlite3_bind_int64(stmt, 2, *logged_at);
+    } else {
+      sqlite3_bind_null(stmt, 2);
+    }
+
+    const int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (result != SQLITE_DONE) {
+      ++stats.failed;
+      return;
+    }
+
+    if (++in_batch >= m_batchSize) {
+      flush_batch();
+      m_database.execute_sql("COMMIT; BEGIN IMMEDIATE;");
+    }
+  };
+
+  try {
+    ImportRecord record;
+    if (format == TransferFormat::Csv) {
+      std::streambuf& buffer = *input.rdbuf();
+      std::vector<std::string> fields;
+      CsvLayout layout;
+      bool first = true;
+      while (read_csv_record(buffer, fields)) {
+        if (fields.size() == 1 && fields[0].empty()) continue;
+        if (first) {
+          first = false;
+          if (detect_csv_layout(fields, layout)) continue;
+        }
+        record.tea_name = csv_field(fields, layout.name).value_or("");
+        record.local_time = csv_field(fields, layout.local_time);
+        record.utc_time = csv_field(fields, layout.utc_time);
+        insert(record);
+      }
+    } else {
+      std::string line;
+      std::unordered_map<std::string, std::string> values;
+      while (std::getline(input, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        if (!JsonLineParser(line).parse(values)) {
+          ++record_number;
+          std::cerr << "Record " << record_number << ": malformed JSON"
+                    << std::endl;
+          ++stats.failed;
+          continue;
+        }
+        auto field = [&values](const char* key) -> std::optional<std::string> {
+          auto found = values.find(key);
+          if (found == values.end() || found->second.empty()) {
+            return std::nullopt;
+          }
+          return found->second;
+        };
+        record.tea_name = field("tea_name").value_or("");
+        record.local_time = field("local_time");
+        record.utc_time = field("utc_time");
+        insert(record);
+      }
+    }
+    flush_batch();
+  } catch (...) {
+    m_database.finalize_statement(stmt);
+    try {
+      m_database.execute_sql("ROLLBACK;");
+      // earlier batches were committed
+      m_database.reload_catalogue();
+    } catch (const std::exception& e) {
+      std::cerr << "Rollback failed: " << e.what() << std::endl;
+    }
+    throw;
+  }
+
+  m_database.finalize_statement(stmt);
+  m_database.execute_sql("COMMIT; DROP TABLE temp.import_batch;");
+  m_database.reload_catalogue();
+  return stats;
+}
+
+TeaExporter::TeaExporter(TeaDatabase& database) : m_database(database) {}
+
+/// @brief writes every entry in id order
+/// @param output
+/// @param format
+/// @return number of exported rows
+TransferStats TeaExporter::export_log(std::ostream& output,
+                                      TransferFormat format) {
+  TransferStats stats;
+  if (format == TransferFormat::Csv) {
+    output << "id,tea_name,local_time,utc_time\n";
+  }
+
+  m_database.for_each_entry(
+      "SELECT id, tea_name, logged_at FROM tea_database ORDER BY id;", {},
+      [&](const TeaLogRow& row) {
+        const std::string local_time = format_local_time(row.logged_at);
+        const std::string utc_time = format_timestamp(row.logged_at);
+        if (format == TransferFormat::Csv) {
+          output << row.id << ',';
+          write_csv_field(output, row.tea_name);
+          output.put(',');
+          write_csv_field(output, local_time);
+          output.put(',');
+          write_csv_field(output, utc_time);
+          output.put('\n');
+        } else {
+          output << "{\"id\":" << row.id << ",\"tea_name\":";
+          write_json_string(output, row.tea_name);
+          output << ",\"local_time\":";
+          write_json_string(output, local_time);
+          output << ",\"utc_time\":";
+          write_json_string(output, utc_time);
+          output << "}\n";
+        }
+        ++stats.rows;
+      });
+  return stats;
+}
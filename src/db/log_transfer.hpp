@@ -0,0 +1,52 @@
+#ifndef LOG_TRANSFER_HPP
+#define LOG_TRANSFER_HPP
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "db_handler.hpp"
+
+/// @brief file formats understood by the importer and exporter
+enum class TransferFormat { Csv, Jsonl };
+
+/// @brief counts of a finished import or export
+struct TransferStats {
+  size_t rows = 0;
+  size_t failed = 0;
+};
+
+/// @brief Streams tea logs from CSV or JSONL into the database. Records are
+/// parsed one at a time and staged with a single prepared statement, then
+/// moved into the log and committed every batch_size rows, so files of any
+/// size can be loaded.
+/// The utc_time of a record is kept, or else its local_time read in this
+/// machine's time zone; records with neither are logged at the current time.
+class TeaImporter {
+ public:
+  TeaImporter(TeaDatabase& database, size_t batch_size = 50000);
+
+  TransferStats import_log(std::istream& input, TransferFormat format);
+
+ private:
+  TeaDatabase& m_database;
+  size_t m_batchSize;
+};
+
+/// @brief Streams the whole log out as CSV or JSONL, writing each row as it
+/// is stepped instead of collecting entries first.
+class TeaExporter {
+ public:
+  explicit TeaExporter(TeaDatabase& database);
+
+  TransferStats export_log(std::ostream& output, TransferFormat format);
+
+ private:
+  TeaDatabase& m_database;
+};
+
+bool transfer_format_from_name(const std::string& name,
+                               TransferFormat& format);
+
+#endif
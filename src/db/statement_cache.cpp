@@ -0,0 +1,102 @@
+#include "statement_cache.hpp"
+
+#include <stdexcept>
+
+/// @brief creates an empty cache for the given connection
+/// @param db
+/// @param capacity maximum number of statements kept prepared
+StatementCache::StatementCache(sqlite3* db, std::size_t capacity)
+    : m_db(db), m_capacity(capacity > 0 ? capacity : 1) {}
+
+/// @brief finalizes every cached statement, including any still in use, so
+/// the connection can close; handles still held are dangling afterwards
+StatementCache::~StatementCache() {
+  for (const Entry& entry : m_entries) sqlite3_finalize(entry.stmt);
+}
+
+/// @brief returns a ready to bind statement for the SQL, preparing it only if
+/// it is not already cached. If the cached statement is still in use (nested
+/// queries) a temporary statement is handed out instead.
+/// @param sql
+/// @return statement which must be given back with release()
+sqlite3_stmt* StatementCache::acquire(const std::string& sql) {
+  auto found = m_bySql.find(sql);
+  if (found != m_bySql.end()) {
+    EntryList::iterator entry = found->second;
+    if (!entry->in_use) {
+      ++m_hits;
+      entry->in_use = true;
+      m_entries.splice(m_entries.begin(), m_entries, entry);
+      return entry->stmt;
+    }
+    ++m_misses;
+    return prepare(sql);
+  }
+
+  ++m_misses;
+  sqlite3_stmt* stmt = prepare(sql);
+  m_entries.push_front(Entry{sql, stmt, true});
+  m_bySql.emplace(sql, m_entries.begin());
+  m_byStmt.emplace(stmt, m_entries.begin());
+  evict_idle();
+  return stmt;
+}
+
+/// @brief resets the statement so it can be reused. Statements not owned by
+/// the cache are finalized.
+/// @param stmt
+void StatementCache::release(sqlite3_stmt* stmt) {
+  if (!stmt) return;
+
+  auto found = m_byStmt.find(stmt);
+  if (found == m_byStmt.end()) {
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  found->second->in_use = false;
+  evict_idle();
+}
+
+/// @brief finalizes every idle statement. Statements still in use are kept so
+/// that callers holding them are not left with dangling handles.
+void StatementCache::clear() {
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (it->in_use) {
+      ++it;
+      continue;
+    }
+    m_bySql.erase(it->sql);
+    m_byStmt.erase(it->stmt);
+    sqlite3_finalize(it->stmt);
+    it = m_entries.erase(it);
+  }
+}
+
+sqlite3_stmt* StatementCache::prepare(const std::string& sql) {
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v3(m_db, sql.c_str(), static_cast<int>(sql.size() + 1),
+                         SQLITE_PREPARE_PERSISTENT, &stmt,
+                         nullptr) != SQLITE_OK) {
+    throw std::runtime_error("SQL prepare error: " +
+                             std::string(sqlite3_errmsg(m_db)));
+  }
+  return stmt;
+}
+
+/// @brief drops least recently used idle statements until within capacity
+void StatementCache::evict_idle() {
+  auto it = m_entries.end();
+  while (m_entries.size() > m_capacity && it != m_entries.begin()) {
+    --it;
+    if (it->in_use) continue;
+
+    m_bySql.erase(it->sql);
+    m_byStmt.erase(it->stmt);
+    sqlite3_finalize(it->stmt);
+    it = m_entries.erase(it);
+    ++m_evictions;
+  }
+}
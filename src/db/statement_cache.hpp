@@ -0,0 +1,56 @@
+#ifndef STATEMENT_CACHE_HPP
+#define STATEMENT_CACHE_HPP
+
+#include <sqlite3.h>
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/// @brief Keeps prepared statements alive between calls, keyed by SQL text.
+/// Statements are reset and their bindings cleared when released, and the
+/// least recently used idle statement is finalized once the cache is full.
+class StatementCache {
+ public:
+  StatementCache(sqlite3* db, std::size_t capacity = 32);
+  ~StatementCache();
+
+  StatementCache(const StatementCache&) = delete;
+  StatementCache& operator=(const StatementCache&) = delete;
+
+  sqlite3_stmt* acquire(const std::string& sql);
+  void release(sqlite3_stmt* stmt);
+  void clear();
+
+  std::size_t size() const { return m_entries.size(); }
+  std::size_t capacity() const { return m_capacity; }
+  std::size_t hits() const { return m_hits; }
+  std::size_t misses() const { return m_misses; }
+  std::size_t evictions() const { return m_evictions; }
+
+ private:
+  struct Entry {
+    std::string sql;
+    sqlite3_stmt* stmt;
+    bool in_use;
+  };
+  using EntryList = std::list<Entry>;
+
+  sqlite3_stmt* prepare(const std::string& sql);
+  void evict_idle();
+
+  sqlite3* m_db;
+  std::size_t m_capacity;
+
+  // most recently used entries are kept at the front
+  EntryList m_entries;
+  std::unordered_map<std::string, EntryList::iterator> m_bySql;
+  std::unordered_map<sqlite3_stmt*, EntryList::iterator> m_byStmt;
+
+  std::size_t m_hits = 0;
+  std::size_t m_misses = 0;
+  std::size_t m_evictions = 0;
+};
+
+#endif
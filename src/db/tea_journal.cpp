@@ -0,0 +1,520 @@
+#include "tea_journal.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "../utility/instrumentation.hpp"
+
+// File layout, in this machine's byte order:
+//   header, 64 bytes: magic "TEAJRNL1", u32 record size, u32 unused,
+//                     i64 journal id, u32 CRC-32 of the 24 bytes before it
+//   records, kRecordSize bytes each from offset kHeaderSize:
+//     u32 CRC-32 of the rest of the record
+//     u16 name length, u16 unused
+//     u64 sequence, one more than the record before it
+//     i64 logged at, unix seconds
+//     name, zero padded to kMaxNameLength bytes
+static constexpr size_t kHeaderSize = 64;
+static constexpr char kMagic[8] = {'T', 'E', 'A', 'J', 'R', 'N', 'L', '1'};
+
+static_assert(24 + TeaJournal::kMaxNameLength == TeaJournal::kRecordSize,
+              "the name fills the record after its fixed fields");
+
+/// @brief a record read back out of the journal
+struct JournalRecord {
+  std::uint64_t sequence;
+  std::int64_t logged_at;
+  std::string_view tea_name;  // points into the mapping
+};
+
+/// @brief CRC-32 (IEEE 802.3, as used by zlib and PNG) of a byte range
+static std::uint32_t crc32(const char* data, size_t size) {
+  static const std::array<std::uint32_t, 256> table = [] {
+    std::array<std::uint32_t, 256> entries{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+      }
+      entries[i] = crc;
+    }
+    return entries;
+  }();
+
+  std::uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i) {
+    const auto byte = static_cast<unsigned char>(data[i]);
+    crc = (crc >> 8) ^ table[(crc ^ byte) & 0xFF];
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+static T load(const char* from) {
+  T value;
+  std::memcpy(&value, from, sizeof value);
+  return value;
+}
+
+template <typename T>
+static void store(char* to, T value) {
+  std::memcpy(to, &value, sizeof value);
+}
+
+/// @brief reads the record at from, if it is whole
+/// @return false if its CRC does not match, as for a torn or never written
+/// record
+static bool decode_record(const char* from, JournalRecord& record) {
+  const std::uint32_t crc = crc32(from + 4, TeaJournal::kRecordSize - 4);
+  if (load<std::uint32_t>(from) != crc) return false;
+  const auto length = load<std::uint16_t>(from + 4);
+  if (length == 0 || length > TeaJournal::kMaxNameLength) return false;
+  record.sequence = load<std::uint64_t>(from + 8);
+  record.logged_at = load<std::int64_t>(from + 16);
+  record.tea_name = std::string_view(from + 24, length);
+  return true;
+}
+
+/// @brief PRAGMA data_version, which changes whenever another connection
+/// commits to the database
+static std::int64_t data_version(TeaDatabase& database) {
+  sqlite3_stmt* stmt = database.prepare_statement("PRAGMA data_version;");
+  std::int64_t version = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int64(stmt, 0);
+  database.finalize_statement(stmt);
+  return version;
+}
+
+[[noreturn]] static void throw_errno(const std::string& what,
+                                     const std::string& path) {
+  throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+/// @brief the journal kept next to a database file
+/// @param db_path
+std::string TeaJournal::path_for(const std::string& db_path) {
+  return db_path + ".journal";
+}
+
+/// @brief Opens the journal, creating it if it does not exist, finds where
+/// its records end and starts the thread folding them into the database,
+/// beginning with any a crash left behind.
+/// @param db_path database the records are folded into
+/// @param journal_path
+/// @param options
+/// @param on_folded called on the fold thread with the ids of the entries
+/// each committed fold logged
+TeaJournal::TeaJournal(const std::string& db_path,
+                       const std::string& journal_path,
+                       const JournalOptions& options, FoldHandler on_folded)
+    : m_database(db_path),
+      m_path(journal_path),
+      m_options(options),
+      m_onFolded(std::move(on_folded)) {
+  if (m_options.max_batch == 0) m_options.max_batch = 1;
+  if (m_options.initial_records == 0) m_options.initial_records = 1;
+  m_database.execute_sql(R"(
+      CREATE TABLE IF NOT EXISTS journal_progress (
+          journal_id INTEGER PRIMARY KEY,
+          folded_sequence INTEGER NOT NULL
+      );
+      CREATE TABLE IF NOT EXISTS journal_rejects (
+          journal_id INTEGER NOT NULL,
+          sequence INTEGER NOT NULL,
+          tea_name TEXT NOT NULL,
+          logged_at INTEGER NOT NULL,
+          PRIMARY KEY (journal_id, sequence)
+      );
+  )");
+  m_dataVersion = data_version(m_database);
+
+  m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (m_fd < 0) throw_errno("Cannot open journal", m_path);
+  try {
+    // two writers appending to one mapping would overwrite each other
+    if (::flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+      throw_errno("Cannot lock journal", m_path);
+    }
+    struct stat status;
+    if (::fstat(m_fd, &status) != 0) throw_errno("Cannot stat journal", m_path);
+
+    if (static_cast<size_t>(status.st_size) < kHeaderSize) {
+      std::random_device random;
+      m_journalId = static_cast<std::int64_t>(
+          (std::uint64_t{random()} << 31 ^ random()) & INT64_MAX);
+      map_file(m_options.initial_records);
+      std::memcpy(m_map, kMagic, sizeof kMagic);
+      store<std::uint32_t>(m_map + 8, kRecordSize);
+      store<std::int64_t>(m_map + 16, m_journalId);
+      store<std::uint32_t>(m_map + 24, crc32(m_map, 24));
+      ::msync(m_map, kHeaderSize, MS_SYNC);
+    } else {
+      map_file((status.st_size - kHeaderSize) / kRecordSize);
+      if (std::memcmp(m_map, kMagic, sizeof kMagic) != 0 ||
+          load<std::uint32_t>(m_map + 8) != kRecordSize ||
+          load<std::uint32_t>(m_map + 24) != crc32(m_map, 24)) {
+        throw std::runtime_error("Not a tea journal: " + m_path);
+      }
+      m_journalId = load<std::int64_t>(m_map + 16);
+    }
+    recover();
+  } catch (...) {
+    unmap_file();
+    ::close(m_fd);
+    throw;
+  }
+  m_thread = std::thread(&TeaJournal::run, this);
+}
+
+/// @brief folds every record still in the journal into the database before
+/// closing; records that cannot be folded stay for the next open to replay
+TeaJournal::~TeaJournal() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+  unmap_file();
+  ::close(m_fd);
+}
+
+/// @brief journals a tea logged now
+/// @param tea_name
+/// @return its sequence number, or 0 if the name is empty or too long
+std::uint64_t TeaJournal::append(std::string_view tea_name) {
+  const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  return append(tea_name, now.count());
+}
+
+/// @brief Journals a tea logged at the given time. The record can be read
+/// back after a crash once this returns; it shows up in the database after
+/// the next fold.
+/// @param tea_name
+/// @param logged_at unix seconds
+/// @return its sequence number, or 0 if the name is empty or too long
+std::uint64_t TeaJournal::append(std::string_view tea_name,
+                                 std::int64_t logged_at) {
+  if (tea_name.empty() || tea_name.size() > kMaxNameLength) return 0;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_end == m_capacity) {
+    map_file(std::max(m_capacity * 2, m_options.initial_records));
+  }
+  const std::uint64_t sequence = m_firstSequence + m_end;
+
+  // built aside and copied in whole, so a crash leaves the old bytes or a
+  // record with a bad CRC and never a valid looking mix
+  char record[kRecordSize] = {};
+  store<std::uint16_t>(record + 4, static_cast<std::uint16_t>(tea_name.size()));
+  store<std::uint64_t>(record + 8, sequence);
+  store<std::int64_t>(record + 16, logged_at);
+  std::memcpy(record + 24, tea_name.data(), tea_name.size());
+  store<std::uint32_t>(record, crc32(record + 4, kRecordSize - 4));
+  char* slot = record_at(m_end);
+  std::memcpy(slot, record, kRecordSize);
+  if (m_options.sync_each_append) {
+    static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    char* first_page = m_map + (slot - m_map) / page * page;
+    ::msync(first_page, slot + kRecordSize - first_page, MS_SYNC);
+  }
+
+  if (m_end == m_taken) m_oldestPending = std::chrono::steady_clock::now();
+  ++m_end;
+  const bool batch_full = m_end - m_taken >= m_options.max_batch;
+  lock.unlock();
+  if (batch_full) m_wake.notify_all();
+  return sequence;
+}
+
+/// @brief folds everything journaled so far without waiting for the batch
+/// to fill, and blocks until it is in the database
+/// @return false if a fold failed first; the records are retried later
+bool TeaJournal::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const std::uint64_t target = m_firstSequence + m_end;
+  const std::uint64_t failures = m_failedFolds;
+  m_flushRequested = true;
+  m_wake.notify_all();
+  m_compacted.wait(lock, [this, target, failures] {
+    return m_firstSequence + m_folded >= target || m_failedFolds != failures;
+  });
+  return m_firstSequence + m_folded >= target;
+}
+
+/// @brief writes every record appended so far through to the disk
+void TeaJournal::sync() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ::msync(m_map, kHeaderSize + m_end * kRecordSize, MS_SYNC);
+}
+
+/// @return sequence of the last record appended, 0 if there is none yet
+std::uint64_t TeaJournal::appended_sequence() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_firstSequence + m_end - 1;
+}
+
+/// @return sequence of the last record folded into the database
+std::uint64_t TeaJournal::compacted_sequence() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_firstSequence + m_folded - 1;
+}
+
+/// @brief maps the header and room for this many records, growing the file
+/// first if it is smaller; the blocks are allocated up front so running out
+/// of disk fails here rather than as a SIGBUS on a later append
+void TeaJournal::map_file(size_t records) {
+  const size_t size = kHeaderSize + records * kRecordSize;
+  const int error = ::posix_fallocate(m_fd, 0, static_cast<off_t>(size));
+  if (error != 0) {
+    errno = error;
+    throw_errno("Cannot grow journal", m_path);
+  }
+  void* map =
+      ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (map == MAP_FAILED) throw_errno("Cannot map journal", m_path);
+  unmap_file();
+  m_map = static_cast<char*>(map);
+  m_mapSize = size;
+  m_capacity = records;
+}
+
+void TeaJournal::unmap_file() {
+  if (m_map) ::munmap(m_map, m_mapSize);
+  m_map = nullptr;
+  m_mapSize = 0;
+}
+
+char* TeaJournal::record_at(size_t index) const {
+  return m_map + kHeaderSize + index * kRecordSize;
+}
+
+/// @brief Finds the end of the journal: the first record that is torn,
+/// never written or out of sequence, which after a rewind is whatever is
+/// left over from before it. Records up to the sequence the database last
+/// folded are skipped, and the rest are left for the fold thread to replay.
+void TeaJournal::recover() {
+  std::uint64_t folded_sequence = 0;
+  sqlite3_stmt* stmt = m_database.prepare_statement(
+      "SELECT folded_sequence FROM journal_progress WHERE journal_id = ?;");
+  sqlite3_bind_int64(stmt, 1, m_journalId);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    folded_sequence = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 0));
+  }
+  m_database.finalize_statement(stmt);
+
+  JournalRecord record;
+  std::uint64_t last_sequence = 0;
+  size_t end = 0;
+  while (end < m_capacity && decode_record(record_at(end), record) &&
+         (end == 0 || record.sequence == last_sequence + 1)) {
+    if (end == 0) m_firstSequence = record.sequence;
+    last_sequence = record.sequence;
+    ++end;
+  }
+
+  const std::uint64_t first_unfolded = folded_sequence + 1;
+  if (end == 0 || last_sequence < first_unfolded) {
+    // nothing to replay, so appending starts again at the front
+    m_firstSequence = std::max(last_sequence, folded_sequence) + 1;
+    return;
+  }
+  m_end = end;
+  m_folded = first_unfolded > m_firstSequence
+                 ? static_cast<size_t>(first_unfolded - m_firstSequence)
+                 : 0;
+  m_taken = m_folded;
+  m_recovered = m_end - m_folded;
+  m_oldestPending = std::chrono::steady_clock::now();
+  m_flushRequested = true;
+  Instrumentation::instance().count("journal.recovered", m_recovered);
+}
+
+void TeaJournal::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_wake.wait(lock, [this] { return m_stopping || m_end > m_taken; });
+    if (m_end == m_taken) return;
+
+    // let the batch grow until it is full, old enough or a flush is asked for
+    m_wake.wait_until(lock, m_oldestPending + m_options.max_delay, [this] {
+      return m_stopping || m_flushRequested ||
+             m_end - m_taken >= m_options.max_batch;
+    });
+
+    // copied out, since appending may remap the file while the batch is
+    // being written
+    const size_t end = std::min(m_end, m_taken + m_options.max_batch);
+    std::vector<std::string> tea_names;
+    std::vector<std::int64_t> logged_at;
+    tea_names.reserve(end - m_taken);
+    logged_at.reserve(end - m_taken);
+    JournalRecord record;
+    for (size_t i = m_taken; i < end; ++i) {
+      decode_record(record_at(i), record);
+      tea_names.emplace_back(record.tea_name);
+      logged_at.push_back(record.logged_at);
+    }
+    const std::uint64_t last_sequence = m_firstSequence + end - 1;
+    m_taken = end;
+    if (m_end > m_taken) {
+      m_oldestPending = std::chrono::steady_clock::now();
+    } else {
+      m_flushRequested = false;
+    }
+    lock.unlock();
+
+    const bool folded = fold(tea_names, logged_at, last_sequence);
+
+    lock.lock();
+    if (!folded) {
+      // the records stay put and are retried after a pause; when closing
+      // they are left for the next open to replay
+      m_taken = m_folded;
+      ++m_failedFolds;
+      m_compacted.notify_all();
+      if (m_stopping) return;
+      m_wake.wait_for(lock, m_options.max_delay, [this] { return m_stopping; });
+      if (m_stopping) return;
+      continue;
+    }
+    m_folded = end;
+    if (m_folded == m_end && m_end >= m_options.rewind_records) {
+      m_firstSequence += m_end;
+      m_end = m_taken = m_folded = 0;
+    }
+    m_compacted.notify_all();
+  }
+}
+
+/// @brief Logs a batch of records and advances the journal's folded
+/// sequence in the same transaction, so a crash between the two can neither
+/// lose the batch nor log it twice. Records the log turns away are moved to
+/// journal_rejects in that transaction too, so none is dropped unseen.
+/// @return false if the transaction did not commit
+bool TeaJournal::fold(const std::vector<std::string>& tea_names,
+                      const std::vector<std::int64_t>& logged_at,
+                      std::uint64_t last_sequence) {
+  ScopedTimer timer("journal.fold");
+  std::vector<LogResult> results;
+  size_t rejected = 0;
+  try {
+    m_database.execute_sql("BEGIN IMMEDIATE;");
+    // another connection may have renamed or deleted teas since the last
+    // fold, and the catalogue would log records under ids that are gone
+    const std::int64_t version = data_version(m_database);
+    if (m_catalogueStale || version != m_dataVersion) {
+      m_database.reload_catalogue();
+      m_catalogueStale = false;
+      m_dataVersion = version;
+    }
+    sqlite3_stmt* stmt = m_database.prepare_statement(R"(
+        INSERT INTO journal_progress (journal_id, folded_sequence)
+        VALUES (?, ?)
+        ON CONFLICT (journal_id)
+        DO UPDATE SET folded_sequence = excluded.folded_sequence;
+    )");
+    sqlite3_bind_int64(stmt, 1, m_journalId);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(last_sequence));
+    const int step = sqlite3_step(stmt);
+    m_database.finalize_statement(stmt);
+    if (step != SQLITE_DONE) {
+      throw std::runtime_error("Cannot record journal progress");
+    }
+    // a batch whose transaction is lost leaves none open, which reject
+    // reports so the whole batch is retried
+    results = m_database.log_teas(tea_names, logged_at);
+    rejected = reject(tea_names, logged_at, results, last_sequence);
+    m_database.execute_sql("COMMIT;");
+  } catch (const std::exception& e) {
+    std::cerr << "Journal fold failed: " << e.what() << std::endl;
+    try {
+      m_database.execute_sql("ROLLBACK;");
+    } catch (const std::exception&) {
+      // already rolled back
+    }
+    // the counts of teas logged in the lost transaction are gone again;
+    // if the catalogue cannot be read now, the next fold reads it first
+    try {
+      m_database.reload_catalogue();
+    } catch (const std::exception& reload_error) {
+      std::cerr << "Journal catalogue reload failed: " << reload_error.what()
+                << std::endl;
+      m_catalogueStale = true;
+    }
+    return false;
+  }
+
+  if (rejected > 0) {
+    std::cerr << "Journal fold moved " << rejected
+              << " records to journal_rejects" << std::endl;
+    Instrumentation::instance().count("journal.records_rejected", rejected);
+  }
+  Instrumentation::instance().count("journal.records_folded",
+                                    results.size() - rejected);
+  if (m_onFolded && rejected < results.size()) {
+    std::vector<int> entry_ids;
+    entry_ids.reserve(results.size() - rejected);
+    for (const LogResult& result : results) {
+      if (result.success) entry_ids.push_back(result.id);
+    }
+    m_onFolded(entry_ids);
+  }
+  return true;
+}
+
+/// @brief keeps the records of a batch that failed to log in
+/// journal_rejects, inside the fold's transaction
+/// @param tea_names
+/// @param logged_at
+/// @param results the outcome of logging each record
+/// @param last_sequence sequence of the batch's last record
+/// @return number of records rejected
+size_t TeaJournal::reject(const std::vector<std::string>& tea_names,
+                          const std::vector<std::int64_t>& logged_at,
+                          const std::vector<LogResult>& results,
+                          std::uint64_t last_sequence) {
+  const std::uint64_t first_sequence = last_sequence + 1 - results.size();
+  size_t rejected = 0;
+  sqlite3_stmt* stmt = m_database.prepare_statement(R"(
+      INSERT OR REPLACE INTO journal_rejects
+          (journal_id, sequence, tea_name, logged_at)
+      VALUES (?, ?, ?, ?);
+  )");
+  // a batch whose transaction is lost fails as a whole, and is retried
+  // rather than rejected
+  if (sqlite3_get_autocommit(sqlite3_db_handle(stmt))) {
+    m_database.finalize_statement(stmt);
+    throw std::runtime_error("The fold's transaction was rolled back");
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (results[i].success) continue;
+    sqlite3_bind_int64(stmt, 1, m_journalId);
+    sqlite3_bind_int64(stmt, 2,
+                       static_cast<sqlite3_int64>(first_sequence + i));
+    sqlite3_bind_text(stmt, 3, tea_names[i].c_str(),
+                      static_cast<int>(tea_names[i].size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, logged_at[i]);
+    const int step = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (step != SQLITE_DONE) {
+      m_database.finalize_statement(stmt);
+      throw std::runtime_error("Cannot keep rejected journal records");
+    }
+    ++rejected;
+  }
+  m_database.finalize_statement(stmt);
+  return rejected;
+}
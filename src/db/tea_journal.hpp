@@ -0,0 +1,126 @@
+#ifndef TEA_JOURNAL_HPP
+#define TEA_JOURNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "db_handler.hpp"
+
+/// @brief how the journal grows and when its records are folded into SQLite
+struct JournalOptions {
+  // records folded into SQLite per transaction, and how long the oldest
+  // record waits for a batch to fill
+  size_t max_batch = 4096;
+  std::chrono::milliseconds max_delay = std::chrono::milliseconds(50);
+  // records the file is sized for up front; it doubles whenever it fills
+  size_t initial_records = 65536;
+  // once this many records are all in SQLite, appending starts over at the
+  // front of the file instead of growing it
+  size_t rewind_records = 65536;
+  // msync every record before append returns, so it also survives a power
+  // cut; otherwise a record survives the process crashing as soon as append
+  // returns and reaches the disk when the kernel writes the page back
+  bool sync_each_append = false;
+};
+
+/// @brief Logs teas into an append-only binary file instead of straight into
+/// SQLite, so ingest from automated sources is not bounded by commit
+/// latency. The file is memory-mapped and holds fixed-size records, each
+/// with a sequence number, the time it was logged, the tea name and a CRC-32
+/// over all of it, so appending one is a copy into the mapping. A background
+/// thread with its own connection folds the records into the log in batches,
+/// recording the last sequence folded in the same transaction. A record the
+/// log turns away is kept in the journal_rejects table instead. Opening the
+/// journal after a crash finds its end at the first record that is torn or
+/// out of sequence, and folds in whatever SQLite has not seen yet. The
+/// fold handler, if given, is called on the fold thread after each commit
+/// with the ids of the entries it logged, so a long-lived connection can
+/// catch up with TeaDatabase::load_logged_entries.
+///
+/// One process at a time may have a journal open. Names longer than
+/// kMaxNameLength bytes do not fit a record and are turned away, as are
+/// empty ones.
+class TeaJournal {
+ public:
+  static constexpr size_t kRecordSize = 128;
+  static constexpr size_t kMaxNameLength = 104;
+
+  using FoldHandler = std::function<void(const std::vector<int>& entry_ids)>;
+
+  TeaJournal(const std::string& db_path, const std::string& journal_path,
+             const JournalOptions& options = JournalOptions(),
+             FoldHandler on_folded = nullptr);
+  ~TeaJournal();
+
+  TeaJournal(const TeaJournal&) = delete;
+  TeaJournal& operator=(const TeaJournal&) = delete;
+
+  std::uint64_t append(std::string_view tea_name);
+  std::uint64_t append(std::string_view tea_name, std::int64_t logged_at);
+  bool flush();
+  void sync();
+
+  std::uint64_t appended_sequence() const;
+  std::uint64_t compacted_sequence() const;
+  size_t recovered() const { return m_recovered; }
+
+  static std::string path_for(const std::string& db_path);
+
+ private:
+  void map_file(size_t records);
+  void unmap_file();
+  void recover();
+  void run();
+  bool fold(const std::vector<std::string>& tea_names,
+            const std::vector<std::int64_t>& logged_at,
+            std::uint64_t last_sequence);
+  size_t reject(const std::vector<std::string>& tea_names,
+                const std::vector<std::int64_t>& logged_at,
+                const std::vector<LogResult>& results,
+                std::uint64_t last_sequence);
+  char* record_at(size_t index) const;
+
+  TeaDatabase m_database;
+  std::string m_path;
+  JournalOptions m_options;
+  FoldHandler m_onFolded;
+  int m_fd = -1;
+  char* m_map = nullptr;
+  size_t m_mapSize = 0;
+  size_t m_capacity = 0;
+  std::int64_t m_journalId = 0;
+  size_t m_recovered = 0;
+  // set when a failed fold could not reread the catalogue; used only by the
+  // fold thread
+  bool m_catalogueStale = false;
+  // PRAGMA data_version when the catalogue was last read; used only by the
+  // fold thread once it has started
+  std::int64_t m_dataVersion = 0;
+
+  // Records [0, m_end) hold sequences m_firstSequence onwards. Those before
+  // m_folded are in SQLite, and those before m_taken are in SQLite or in the
+  // batch being folded.
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_compacted;
+  bool m_stopping = false;
+  bool m_flushRequested = false;
+  std::uint64_t m_firstSequence = 1;
+  size_t m_end = 0;
+  size_t m_taken = 0;
+  size_t m_folded = 0;
+  std::uint64_t m_failedFolds = 0;
+  std::chrono::steady_clock::time_point m_oldestPending;
+
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "tea_statistics.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+StatisticsQuery::StatisticsQuery(TeaDatabase& database)
+    : m_database(database) {}
+
+/// @brief steps a statement to the end, passing each row to the callback,
+/// and hands it back
+template <typename RowHandler>
+static void read_rows(TeaDatabase& database, sqlite3_stmt* stmt,
+                      RowHandler handle_row) {
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    handle_row(stmt);
+  }
+  if (rc != SQLITE_DONE) {
+    std::string error_msg =
+        "Statistics query failed: " +
+        std::string(sqlite3_errmsg(sqlite3_db_handle(stmt)));
+    database.finalize_statement(stmt);
+    throw std::runtime_error(error_msg);
+  }
+  database.finalize_statement(stmt);
+}
+
+/// @brief reads every statistic shown on the profile page
+/// @param top_teas number of most logged teas to include
+/// @return the statistics
+TeaStatistics StatisticsQuery::summary(size_t top_teas) {
+  TeaStatistics statistics;
+
+  read_rows(m_database,
+            m_database.prepare_statement(
+                "SELECT coalesce(sum(log_count), 0), count(*) FROM teas"
+                " WHERE log_count > 0;"),
+            [&statistics](sqlite3_stmt* stmt) {
+              statistics.total_entries =
+                  static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+              statistics.distinct_teas =
+                  static_cast<size_t>(sqlite3_column_int64(stmt, 1));
+            });
+
+  statistics.top_teas = this->top_teas(top_teas);
+
+  read_rows(m_database,
+            m_database.prepare_statement(
+                "SELECT hour_of_week, count FROM tea_hourly_counts;"),
+            [&statistics](sqlite3_stmt* stmt) {
+              const int hour_of_week = sqlite3_column_int(stmt, 0);
+              const auto count =
+                  static_cast<size_t>(sqlite3_column_int64(stmt, 1));
+              if (hour_of_week < 0 || hour_of_week >= 7 * 24) return;
+              statistics.by_hour[hour_of_week % 24] += count;
+              statistics.by_weekday[hour_of_week / 24] += count;
+            });
+
+  std::int64_t today = 0;
+  read_rows(m_database,
+            m_database.prepare_statement(
+                "SELECT unixepoch('now', 'localtime') / 86400;"),
+            [&today](sqlite3_stmt* stmt) {
+              today = sqlite3_column_int64(stmt, 0);
+            });
+
+  std::vector<std::int64_t> days;
+  read_rows(m_database,
+            m_database.prepare_statement(
+                "SELECT day FROM tea_daily_counts WHERE count > 0"
+                " ORDER BY day DESC;"),
+            [&days](sqlite3_stmt* stmt) {
+              days.push_back(sqlite3_column_int64(stmt, 0));
+            });
+
+  // days are newest first; the current streak is the run starting at the
+  // newest day, if that is today or yesterday
+  statistics.days_logged = days.size();
+  size_t run = 0;
+  for (size_t i = 0; i < days.size(); ++i) {
+    run = i > 0 && days[i] == days[i - 1] - 1 ? run + 1 : 1;
+    statistics.longest_streak = std::max(statistics.longest_streak, run);
+    if (run == i + 1 && days.front() >= today - 1) {
+      statistics.current_streak = run;
+    }
+  }
+
+  return statistics;
+}
+
+/// @brief the most logged teas, read through the index on the counts
+/// @param limit
+/// @return counts, most logged first
+std::vector<TeaCount> StatisticsQuery::top_teas(size_t limit) {
+  std::vector<TeaCount> teas;
+  sqlite3_stmt* stmt = m_database.prepare_statement(
+      "SELECT name, log_count FROM teas WHERE log_count > 0"
+      " ORDER BY log_count DESC LIMIT ?;");
+  sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(limit));
+  read_rows(m_database, stmt, [&teas](sqlite3_stmt* stmt) {
+    teas.push_back(
+        {reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) ?: "",
+         static_cast<size_t>(sqlite3_column_int64(stmt, 1))});
+  });
+  return teas;
+}
+
+/// @brief entries per local calendar day, for charts over a period
+/// @param from_day first day, inclusive, in days since 1970-01-01
+/// @param to_day last day, exclusive
+/// @return days that have entries, oldest first
+std::vector<DayCount> StatisticsQuery::daily_counts(std::int64_t from_day,
+                                                    std::int64_t to_day) {
+  std::vector<DayCount> days;
+  sqlite3_stmt* stmt = m_database.prepare_statement(
+      "SELECT day, count FROM tea_daily_counts"
+      " WHERE day >= ? AND day < ? AND count > 0 ORDER BY day;");
+  sqlite3_bind_int64(stmt, 1, from_day);
+  sqlite3_bind_int64(stmt, 2, to_day);
+  read_rows(m_database, stmt, [&days](sqlite3_stmt* stmt) {
+    days.push_back({sqlite3_column_int64(stmt, 0),
+                    static_cast<size_t>(sqlite3_column_int64(stmt, 1))});
+  });
+  return days;
+}
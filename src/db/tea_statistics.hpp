@@ -0,0 +1,44 @@
+#ifndef TEA_STATISTICS_HPP
+#define TEA_STATISTICS_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "db_handler.hpp"
+
+/// @brief number of entries logged on one local calendar day
+struct DayCount {
+  std::int64_t day;  // days since 1970-01-01
+  size_t count;
+};
+
+/// @brief summary of the whole log as shown on the profile page
+struct TeaStatistics {
+  size_t total_entries = 0;
+  size_t distinct_teas = 0;
+  std::vector<TeaCount> top_teas;  // most logged first
+  std::array<size_t, 24> by_hour{};
+  std::array<size_t, 7> by_weekday{};  // Sunday first
+  size_t days_logged = 0;
+  size_t current_streak = 0;  // consecutive days up to today or yesterday
+  size_t longest_streak = 0;
+};
+
+/// @brief Reads statistics from the summary tables TeaDatabase keeps up to
+/// date on every write, so the cost depends on the number of distinct teas
+/// and days, never on the number of log entries.
+class StatisticsQuery {
+ public:
+  explicit StatisticsQuery(TeaDatabase& database);
+
+  TeaStatistics summary(size_t top_teas = 10);
+  std::vector<TeaCount> top_teas(size_t limit);
+  std::vector<DayCount> daily_counts(std::int64_t from_day,
+                                     std::int64_t to_day);
+
+ private:
+  TeaDatabase& m_database;
+};
+
+#endif
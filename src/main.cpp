@@ -1,16 +1,55 @@
 #include <gtkmm/application.h>
 
+#include <cstring>
 #include <iostream>
+#include <string>
 
 #include "app.hpp"
+#include "cli/transfer_command.hpp"
+#include "db/db_handler.hpp"
+#include "utility/instrumentation.hpp"
+
+/// @brief takes the --db PATH and --journal options out of the arguments,
+/// since GTK would reject them as unknown
+/// @param use_journal set if --journal was given, to log through the
+/// journal next to the database
+/// @return the path, or the default one if not given
+static std::string take_database_options(int& argc, char* argv[],
+                                         bool& use_journal) {
+  std::string db_path;
+  int kept = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+      db_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--journal") == 0) {
+      use_journal = true;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+  argv[argc] = nullptr;
+  return db_path.empty() ? default_database_path() : db_path;
+}
+
 // Reference from Gtkmm
 int main(int argc, char* argv[]) {
+  if (TransferCommand::matches(argc, argv)) {
+    return TransferCommand::run(argc, argv);
+  }
+
+  configure_instrumentation_from_environment();
+  const auto started = Instrumentation::Clock::now();
   try {
+    bool use_journal = false;
+    const std::string db_path =
+        take_database_options(argc, argv, use_journal);
     auto app = Gtk::Application::create("tea.logger");
 
-    return app->make_window_and_run<App>(argc, argv);
+    return app->make_window_and_run<App>(argc, argv, db_path, use_journal,
+                                         started);
   } catch (const std::exception& e) {
     std::cerr << "Error: " << e.what() << std::endl;
     return 1;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,50 @@
+#include "compact_tea_log.hpp"
+
+#include <algorithm>
+
+/// @brief finds or adds a name
+/// @param name
+/// @return id of the name
+std::uint32_t TeaNameTable::intern(std::string_view name) {
+  auto found = m_ids.find(name);
+  if (found != m_ids.end()) return found->second;
+
+  const auto name_id = static_cast<std::uint32_t>(m_names.size());
+  m_names.emplace_back(name);
+  m_ids.emplace(m_names.back(), name_id);
+  return name_id;
+}
+
+const std::string& TeaNameTable::name(std::uint32_t name_id) const {
+  return m_names[name_id];
+}
+
+/// @brief copies a row read from a query into the log
+/// @param row
+void CompactTeaLog::append(const TeaLogRow& row) {
+  m_rows.push_back({row.id, m_names.intern(row.tea_name), row.logged_at});
+}
+
+/// @brief removes the entries with the given ids. Their names are kept in
+/// the table, which only lives as long as the log.
+/// @param ids
+void CompactTeaLog::erase_ids(const std::unordered_set<int>& ids) {
+  m_rows.erase(std::remove_if(m_rows.begin(), m_rows.end(),
+                              [&ids](const CompactTeaEntry& row) {
+                                return ids.count(row.id) > 0;
+                              }),
+               m_rows.end());
+}
+
+void CompactTeaLog::clear() {
+  m_rows.clear();
+  m_names = TeaNameTable();
+}
+
+/// @brief builds the full entry for a row, for handing to the view
+/// @param index
+/// @return the entry
+TeaLogEntry CompactTeaLog::entry(size_t index) const {
+  const CompactTeaEntry& row = m_rows[index];
+  return TeaLogEntry(row.id, name(row), row.logged_at);
+}
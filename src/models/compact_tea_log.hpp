@@ -0,0 +1,60 @@
+#ifndef COMPACT_TEA_LOG_HPP
+#define COMPACT_TEA_LOG_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tea.hpp"
+
+/// @brief Stores each distinct tea name once and hands out small ids for it.
+/// Names stay at a fixed address, so the lookup table can key on views of
+/// the stored strings. A copy would key on the source's strings, so the
+/// table is move-only; moving a deque keeps its elements where they are.
+class TeaNameTable {
+ public:
+  TeaNameTable() = default;
+  TeaNameTable(const TeaNameTable&) = delete;
+  TeaNameTable& operator=(const TeaNameTable&) = delete;
+  TeaNameTable(TeaNameTable&&) = default;
+  TeaNameTable& operator=(TeaNameTable&&) = default;
+
+  std::uint32_t intern(std::string_view name);
+  const std::string& name(std::uint32_t name_id) const;
+  size_t size() const { return m_names.size(); }
+
+ private:
+  std::deque<std::string> m_names;
+  std::unordered_map<std::string_view, std::uint32_t> m_ids;
+};
+
+/// @brief A list of entries held as CompactTeaEntry rows plus a name table.
+/// A log of many entries over few teas costs a fixed 16 bytes per entry
+/// instead of a TeaLogEntry with a heap string of its own. Full entries are
+/// only built on request.
+class CompactTeaLog {
+ public:
+  void append(const TeaLogRow& row);
+  void erase_ids(const std::unordered_set<int>& ids);
+  void clear();
+
+  size_t size() const { return m_rows.size(); }
+  bool empty() const { return m_rows.empty(); }
+  const CompactTeaEntry& operator[](size_t index) const {
+    return m_rows[index];
+  }
+  const std::string& name(const CompactTeaEntry& row) const {
+    return m_names.name(row.name_id);
+  }
+  TeaLogEntry entry(size_t index) const;
+
+ private:
+  TeaNameTable m_names;
+  std::vector<CompactTeaEntry> m_rows;
+};
+
+#endif
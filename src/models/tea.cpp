@@ -1 +1,50 @@
-#include "tea.hpp"
\ No newline at end of file
+#include "tea.hpp"
+
+#include <charconv>
+
+static constexpr char kHexDigits[] = "0123456789abcdef";
+
+/// @brief the cursor as a printable token: the id, a dot and the name's bytes
+/// in hex, or an empty string for the start of the log
+/// @return the token
+std::string TeaLogCursor::encode() const {
+  if (!m_after) return "";
+  std::string token = std::to_string(m_after->id) + '.';
+  token.reserve(token.size() + m_after->tea_name.size() * 2);
+  for (unsigned char c : m_after->tea_name) {
+    token += kHexDigits[c >> 4];
+    token += kHexDigits[c & 0x0f];
+  }
+  return token;
+}
+
+/// @brief reads a token made by encode
+/// @param token
+/// @return the cursor, or nothing if the token is malformed
+std::optional<TeaLogCursor> TeaLogCursor::decode(std::string_view token) {
+  if (token.empty()) return TeaLogCursor();
+
+  const size_t dot = token.find('.');
+  if (dot == std::string_view::npos || (token.size() - dot - 1) % 2 != 0) {
+    return std::nullopt;
+  }
+  int id = 0;
+  const char* id_end = token.data() + dot;
+  const auto [end, error] = std::from_chars(token.data(), id_end, id);
+  if (error != std::errc() || end != id_end) return std::nullopt;
+
+  auto nibble = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  };
+  std::string name;
+  name.reserve((token.size() - dot - 1) / 2);
+  for (size_t i = dot + 1; i < token.size(); i += 2) {
+    const int high = nibble(token[i]);
+    const int low = nibble(token[i + 1]);
+    if (high < 0 || low < 0) return std::nullopt;
+    name += static_cast<char>(high << 4 | low);
+  }
+  return TeaLogCursor(TeaLogKey{std::move(name), id});
+}
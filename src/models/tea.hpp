@@ -1,20 +1,76 @@
 #ifndef TEA_HPP
 #define TEA_HPP
 
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
-/// @brief represents an entry in the database
+/// @brief represents an entry in the database. The time it was logged is
+/// kept in seconds since the epoch and converted to local time for display.
 struct TeaLogEntry {
   int id;
   std::string tea_name;
-  std::string local_time;
-  std::string utc_time;
+  std::int64_t logged_at;
 
-  TeaLogEntry(int entryId, const std::string& name, const std::string& local,
-              const std::string& utc)
-      : id(entryId), tea_name(name), local_time(local), utc_time(utc) {}
+  TeaLogEntry(int entryId, const std::string& name, std::int64_t loggedAt)
+      : id(entryId), tea_name(name), logged_at(loggedAt) {}
 
-  TeaLogEntry() : id(0), tea_name(""), local_time(""), utc_time("") {}
+  TeaLogEntry() : id(0), tea_name(""), logged_at(0) {}
+};
+
+/// @brief an entry as read from a query, pointing straight at the column
+/// text. The views are only valid until the visitor it is passed to returns.
+struct TeaLogRow {
+  int id;
+  std::string_view tea_name;
+  std::int64_t logged_at;
+};
+
+/// @brief a stored entry without strings: the name is an index into a name
+/// table
+struct CompactTeaEntry {
+  int id;
+  std::uint32_t name_id;
+  std::int64_t logged_at;
+};
+
+/// @brief position of an entry in the log when ordered by name
+struct TeaLogKey {
+  std::string tea_name;
+  int id;
+
+  bool operator<(const TeaLogKey& other) const {
+    return tea_name < other.tea_name ||
+           (tea_name == other.tea_name && id < other.id);
+  }
+};
+
+/// @brief Where a page of the (tea_name, id) ordered log starts: either the
+/// beginning of the log or just after a given key. Callers treat it as
+/// opaque and only pass back what find_tea_page returned, or its encoded
+/// token, e.g. from a script paging through the CLI.
+class TeaLogCursor {
+ public:
+  TeaLogCursor() = default;
+  explicit TeaLogCursor(TeaLogKey after) : m_after(std::move(after)) {}
+
+  bool at_start() const { return !m_after; }
+  const std::optional<TeaLogKey>& after() const { return m_after; }
+
+  std::string encode() const;
+  static std::optional<TeaLogCursor> decode(std::string_view token);
+
+ private:
+  std::optional<TeaLogKey> m_after;
+};
+
+/// @brief one page of the ordered log and the cursor of the page after it,
+/// which is empty on the last page
+struct TeaLogPage {
+  std::vector<TeaLogEntry> entries;
+  std::optional<TeaLogCursor> next;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "tea_list_model.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <unordered_set>
+
+#include "../utility/instrumentation.hpp"
+
+TeaRow::TeaRow(TeaLogEntry entry) : m_entry(std::move(entry)) {}
+
+/// @brief wraps an entry so it can be handed to list views
+/// @param entry
+/// @return the new item
+Glib::RefPtr<TeaRow> TeaRow::create(TeaLogEntry entry) {
+  return Glib::make_refptr_for_instance<TeaRow>(new TeaRow(std::move(entry)));
+}
+
+TeaListModel::TeaListModel(TeaDatabase& database)
+    : Glib::ObjectBase(typeid(TeaListModel)),
+      Glib::Object(),
+      Gio::ListModel(),
+      m_database(database) {}
+
+/// @brief creates an empty model reading from the database
+/// @param database
+/// @return the new model
+Glib::RefPtr<TeaListModel> TeaListModel::create(TeaDatabase& database) {
+  return Glib::make_refptr_for_instance<TeaListModel>(
+      new TeaListModel(database));
+}
+
+/// @brief shows the whole log, reading only the row count up front
+void TeaListModel::show_all() {
+  const guint old_count = get_n_items_vfunc();
+
+  m_showingAll = true;
+  m_entries.clear();
+  m_pages.clear();
+  m_pageOrder.clear();
+  m_anchors.clear();
+  try {
+    m_count = m_database.count_tea_entries();
+  } catch (const std::exception& e) {
+    std::cerr << "Error executing database query: " << e.what() << std::endl;
+    m_count = 0;
+  }
+
+  items_changed(0, old_count, get_n_items_vfunc());
+}
+
+/// @brief shows a fixed set of entries, such as search results
+/// @param entries
+void TeaListModel::show_entries(CompactTeaLog entries) {
+  ScopedTimer timer("model.show_entries");
+  const guint old_count = get_n_items_vfunc();
+
+  m_showingAll = false;
+  m_pages.clear();
+  m_pageOrder.clear();
+  m_anchors.clear();
+  m_count = 0;
+  m_entries = std::move(entries);
+
+  items_changed(0, old_count, get_n_items_vfunc());
+}
+
+/// @brief inserts a newly logged entry at its position in the whole log.
+/// Search results are left to the caller to re-run.
+/// @param entry
+void TeaListModel::entry_logged(const TeaLogEntry& entry) {
+  if (!m_showingAll) return;
+
+  const size_t position = position_of({entry.tea_name, entry.id});
+  ++m_count;
+  drop_pages_from(position);
+  shift_anchors(position, 1);
+  items_changed(position, 0, 1);
+}
+
+/// @brief moves a renamed entry to its new position in the whole log. The
+/// rows between the old and new position are reported as changed in one
+/// step so the view never sees an intermediate state.
+/// @param tea_id
+/// @param old_name
+/// @param new_name
+void TeaListModel::entry_renamed(int tea_id, const std::string& old_name,
+                                 const std::string& new_name) {
+  if (!m_showingAll) return;
+
+  const TeaLogKey old_key{old_name, tea_id};
+  const TeaLogKey new_key{new_name, tea_id};
+
+  // take the row out at its old position, then find where it goes among the
+  // remaining rows; the database already holds it under the new key
+  const size_t old_position = position_of(old_key, &new_key);
+  shift_anchors(old_position, -1, 1);
+  const size_t new_position = position_of(new_key);
+  shift_anchors(new_position, 1);
+
+  const size_t first = std::min(old_position, new_position);
+  const size_t changed = std::max(old_position, new_position) - first + 1;
+  drop_pages_from(first);
+  items_changed(first, changed, changed);
+}
+
+/// @brief removes the entries deleted under a name. In the whole log they
+/// are one contiguous run starting at the first key with that name.
+/// @param tea_name
+/// @param deleted_ids
+void TeaListModel::entries_deleted(const std::string& tea_name,
+                                   const std::vector<int>& deleted_ids) {
+  if (deleted_ids.empty()) return;
+
+  if (!m_showingAll) {
+    const guint old_count = get_n_items_vfunc();
+    m_entries.erase_ids(
+        std::unordered_set<int>(deleted_ids.begin(), deleted_ids.end()));
+    items_changed(0, old_count, get_n_items_vfunc());
+    return;
+  }
+
+  const size_t position = position_of({tea_name, INT_MIN});
+  const size_t removed = std::min(deleted_ids.size(), m_count - position);
+  m_count -= removed;
+  drop_pages_from(position);
+  shift_anchors(position, -static_cast<long>(removed), removed);
+  items_changed(position, removed, 0);
+}
+
+GType TeaListModel::get_item_type_vfunc() { return G_TYPE_OBJECT; }
+
+guint TeaListModel::get_n_items_vfunc() {
+  return static_cast<guint>(m_showingAll ? m_count : m_entries.size());
+}
+
+gpointer TeaListModel::get_item_vfunc(guint position) {
+  try {
+    std::optional<TeaLogEntry> entry = fetch(position);
+    if (!entry) return nullptr;
+
+    auto row = TeaRow::create(std::move(*entry));
+    return g_object_ref(row->gobj());
+  } catch (const std::exception& e) {
+    std::cerr << "Error executing database query: " << e.what() << std::endl;
+    return nullptr;
+  }
+}
+
+/// @brief builds the entry at a position, loading its page if needed
+/// @param position
+/// @return the entry, or nothing past the end
+std::optional<TeaLogEntry> TeaListModel::fetch(size_t position) {
+  if (!m_showingAll) {
+    if (position >= m_entries.size()) return std::nullopt;
+    return m_entries.entry(position);
+  }
+  if (position >= m_count) return std::nullopt;
+
+  const std::vector<TeaLogEntry>& rows = load_page(position / kPageSize);
+  const size_t offset = position % kPageSize;
+  if (offset >= rows.size()) return std::nullopt;
+  return rows[offset];
+}
+
+/// @brief returns a cached page or reads it from the nearest known key before
+/// it, evicting the least recently used page when the cache is full
+/// @param page
+/// @return rows of the page
+const std::vector<TeaLogEntry>& TeaListModel::load_page(size_t page) {
+  ScopedTimer timer("model.load_page");
+  auto cached = m_pages.find(page);
+  if (cached != m_pages.end()) {
+    m_pageOrder.remove(page);
+    m_pageOrder.push_front(page);
+    return cached->second;
+  }
+
+  const size_t start = page * kPageSize;
+  std::optional<TeaLogKey> after;
+  size_t offset = start;
+  auto anchor = std::lower_bound(
+      m_anchors.begin(), m_anchors.end(), start,
+      [](const Anchor& a, size_t position) { return a.position < position; });
+  if (anchor != m_anchors.begin()) {
+    --anchor;
+    after = anchor->key;
+    offset = start - anchor->position - 1;
+  }
+
+  // a page right after a known key, such as the next page while scrolling,
+  // is read by key alone; a jump further ahead skips from the nearest one
+  std::vector<TeaLogEntry> rows =
+      offset == 0
+          ? m_database
+                .find_tea_page(after ? TeaLogCursor(*after) : TeaLogCursor(),
+                               kPageSize)
+                .entries
+          : m_database.find_tea_entries_after(after, offset, kPageSize);
+  if (!rows.empty()) {
+    add_anchor(start, rows.front());
+    add_anchor(start + rows.size() - 1, rows.back());
+  }
+
+  m_pageOrder.push_front(page);
+  std::vector<TeaLogEntry>& stored = m_pages[page] = std::move(rows);
+  while (m_pageOrder.size() > kMaxCachedPages) {
+    const size_t evicted = m_pageOrder.back();
+    m_pages.erase(evicted);
+    m_pageOrder.pop_back();
+    drop_anchors(evicted * kPageSize, (evicted + 1) * kPageSize);
+  }
+  return stored;
+}
+
+/// @brief remembers the key of a row just read at a position
+/// @param position
+/// @param row
+void TeaListModel::add_anchor(size_t position, const TeaLogEntry& row) {
+  auto it = std::lower_bound(
+      m_anchors.begin(), m_anchors.end(), position,
+      [](const Anchor& a, size_t p) { return a.position < p; });
+  TeaLogKey key{row.tea_name, row.id};
+  if (it != m_anchors.end() && it->position == position) {
+    it->key = std::move(key);
+  } else {
+    m_anchors.insert(it, Anchor{position, std::move(key)});
+  }
+}
+
+/// @brief forgets the anchors of a page leaving the cache
+/// @param first first position of the range
+/// @param last position just past the range
+void TeaListModel::drop_anchors(size_t first, size_t last) {
+  auto by_position = [](const Anchor& a, size_t p) {
+    return a.position < p;
+  };
+  auto begin =
+      std::lower_bound(m_anchors.begin(), m_anchors.end(), first, by_position);
+  auto end = std::lower_bound(begin, m_anchors.end(), last, by_position);
+  m_anchors.erase(begin, end);
+}
+
+/// @brief finds the position of a key in the whole log by counting only from
+/// the closest anchor before it, found by binary search
+/// @param key
+/// @param missing key of a row already in the database but not yet in the
+/// list, which is left out of the count
+/// @return number of entries ordered before the key
+size_t TeaListModel::position_of(const TeaLogKey& key,
+                                 const TeaLogKey* missing) {
+  auto closest = std::lower_bound(
+      m_anchors.begin(), m_anchors.end(), key,
+      [](const Anchor& a, const TeaLogKey& k) { return a.key < k; });
+
+  size_t position;
+  bool counts_missing = missing && *missing < key;
+  if (closest == m_anchors.begin()) {
+    position = m_database.count_tea_entries_before(key);
+  } else {
+    --closest;
+    position = closest->position + 1 +
+               m_database.count_tea_entries_before(key, closest->key);
+    counts_missing = counts_missing && closest->key < *missing;
+  }
+  return counts_missing ? position - 1 : position;
+}
+
+/// @brief forgets cached pages, and their anchors, whose rows moved because
+/// of a change at the position
+/// @param position
+void TeaListModel::drop_pages_from(size_t position) {
+  const size_t first_page = position / kPageSize;
+  for (auto it = m_pageOrder.begin(); it != m_pageOrder.end();) {
+    if (*it >= first_page) {
+      m_pages.erase(*it);
+      it = m_pageOrder.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  drop_anchors(first_page * kPageSize, SIZE_MAX);
+}
+
+/// @brief keeps anchor positions in step with the log after a change
+/// @param position first position affected
+/// @param delta how far anchors after the change move
+/// @param removed number of positions from position whose anchors are dropped
+void TeaListModel::shift_anchors(size_t position, long delta, size_t removed) {
+  drop_anchors(position, position + removed);
+  for (Anchor& anchor : m_anchors) {
+    if (anchor.position >= position) anchor.position += delta;
+  }
+}
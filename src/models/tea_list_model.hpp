@@ -0,0 +1,91 @@
+#ifndef TEA_LIST_MODEL_HPP
+#define TEA_LIST_MODEL_HPP
+
+#include <giomm/listmodel.h>
+#include <glibmm/object.h>
+
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "../db/db_handler.hpp"
+#include "compact_tea_log.hpp"
+#include "tea.hpp"
+
+/// @brief a single log entry as an item of a Gio::ListModel
+class TeaRow : public Glib::Object {
+ public:
+  static Glib::RefPtr<TeaRow> create(TeaLogEntry entry);
+
+  const TeaLogEntry& entry() const { return m_entry; }
+
+ protected:
+  explicit TeaRow(TeaLogEntry entry);
+
+ private:
+  TeaLogEntry m_entry;
+};
+
+/// @brief Gio::ListModel over the tea log. When showing the whole log only
+/// the row count is read up front; rows are fetched lazily in pages ordered
+/// by (tea_name, id) as the view asks for them and a few recent pages are
+/// kept cached. A page following one already read continues from its last
+/// key, so scrolling costs the same at any depth. Search results, which are
+/// already bounded, are held as is.
+class TeaListModel : public Glib::Object, public Gio::ListModel {
+ public:
+  static Glib::RefPtr<TeaListModel> create(TeaDatabase& database);
+
+  void show_all();
+  void show_entries(CompactTeaLog entries);
+  bool is_showing_all() const { return m_showingAll; }
+
+  void entry_logged(const TeaLogEntry& entry);
+  void entry_renamed(int tea_id, const std::string& old_name,
+                     const std::string& new_name);
+  void entries_deleted(const std::string& tea_name,
+                       const std::vector<int>& deleted_ids);
+
+ protected:
+  explicit TeaListModel(TeaDatabase& database);
+
+  GType get_item_type_vfunc() override;
+  guint get_n_items_vfunc() override;
+  gpointer get_item_vfunc(guint position) override;
+
+ private:
+  static constexpr size_t kPageSize = 256;
+  static constexpr size_t kMaxCachedPages = 8;
+
+  struct Anchor {
+    size_t position;
+    TeaLogKey key;
+  };
+
+  std::optional<TeaLogEntry> fetch(size_t position);
+  size_t position_of(const TeaLogKey& key,
+                     const TeaLogKey* missing = nullptr);
+  const std::vector<TeaLogEntry>& load_page(size_t page);
+  void drop_pages_from(size_t position);
+  void add_anchor(size_t position, const TeaLogEntry& row);
+  void drop_anchors(size_t first, size_t last);
+  void shift_anchors(size_t position, long delta, size_t removed = 0);
+
+  TeaDatabase& m_database;
+  bool m_showingAll = false;
+
+  // whole log mode
+  size_t m_count = 0;
+  std::unordered_map<size_t, std::vector<TeaLogEntry>> m_pages;
+  std::list<size_t> m_pageOrder;  // most recently used first
+  // keys of the first and last rows of the cached pages, used to start page
+  // queries near the page instead of skipping from the first row; ordered
+  // by position, and so by key too
+  std::vector<Anchor> m_anchors;
+
+  // search results mode
+  CompactTeaLog m_entries;
+};
+
+#endif
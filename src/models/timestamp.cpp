@@ -0,0 +1,128 @@
+#include "timestamp.hpp"
+
+#include <cstdio>
+#include <ctime>
+
+/// @brief days from 1970-01-01 to a civil date, valid for any year
+static std::int64_t days_from_civil(std::int64_t year, unsigned month,
+                                    unsigned day) {
+  year -= month <= 2;
+  const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const unsigned day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<std::int64_t>(day_of_era) - 719468;
+}
+
+/// @brief reads a fixed width run of digits
+static bool read_digits(std::string_view text, size_t offset, size_t count,
+                        unsigned& value) {
+  value = 0;
+  for (size_t i = offset; i < offset + count; ++i) {
+    if (text[i] < '0' || text[i] > '9') return false;
+    value = value * 10 + static_cast<unsigned>(text[i] - '0');
+  }
+  return true;
+}
+
+/// @brief splits "YYYY-MM-DD HH:MM:SS" text, as written by SQLite's
+/// datetime(), into a broken down time
+static bool read_fields(std::string_view text, std::tm& fields) {
+  unsigned year, month, day, hour, minute, second;
+  if (text.size() < 19 || text[4] != '-' || text[7] != '-' ||
+      (text[10] != ' ' && text[10] != 'T') || text[13] != ':' ||
+      text[16] != ':' || !read_digits(text, 0, 4, year) ||
+      !read_digits(text, 5, 2, month) || !read_digits(text, 8, 2, day) ||
+      !read_digits(text, 11, 2, hour) || !read_digits(text, 14, 2, minute) ||
+      !read_digits(text, 17, 2, second) || month < 1 || month > 12 ||
+      day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return false;
+  }
+  fields = std::tm();
+  fields.tm_year = static_cast<int>(year) - 1900;
+  fields.tm_mon = static_cast<int>(month) - 1;
+  fields.tm_mday = static_cast<int>(day);
+  fields.tm_hour = static_cast<int>(hour);
+  fields.tm_min = static_cast<int>(minute);
+  fields.tm_sec = static_cast<int>(second);
+  return true;
+}
+
+/// @brief parses UTC text without going through the C library's time zone
+/// handling
+/// @param text "YYYY-MM-DD HH:MM:SS"
+/// @return seconds since the epoch, or kUnknownTime
+std::int64_t parse_timestamp(std::string_view text) {
+  std::tm fields;
+  if (!read_fields(text, fields)) return kUnknownTime;
+  return days_from_civil(fields.tm_year + 1900, fields.tm_mon + 1,
+                         fields.tm_mday) *
+             86400 +
+         fields.tm_hour * 3600 + fields.tm_min * 60 + fields.tm_sec;
+}
+
+/// @brief parses text in the local time zone
+/// @param text "YYYY-MM-DD HH:MM:SS"
+/// @return seconds since the epoch, or kUnknownTime
+std::int64_t parse_local_timestamp(std::string_view text) {
+  std::tm fields;
+  if (!read_fields(text, fields)) return kUnknownTime;
+  fields.tm_isdst = -1;
+  const std::time_t seconds = std::mktime(&fields);
+  return seconds == static_cast<std::time_t>(-1) ? kUnknownTime : seconds;
+}
+
+/// @brief formats seconds since the epoch in UTC the way datetime() does
+/// @param seconds
+/// @return "YYYY-MM-DD HH:MM:SS", or an empty string for kUnknownTime
+std::string format_timestamp(std::int64_t seconds) {
+  if (seconds == kUnknownTime) return "";
+
+  std::int64_t days = seconds / 86400;
+  std::int64_t time_of_day = seconds % 86400;
+  if (time_of_day < 0) {
+    time_of_day += 86400;
+    --days;
+  }
+
+  // inverse of days_from_civil
+  days += 719468;
+  const std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const unsigned day_of_era = static_cast<unsigned>(days - era * 146097);
+  const unsigned year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+       day_of_era / 146096) /
+      365;
+  const unsigned day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const unsigned mp = (5 * day_of_year + 2) / 153;
+  const unsigned day = day_of_year - (153 * mp + 2) / 5 + 1;
+  const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+  const std::int64_t year = year_of_era + era * 400 + (month <= 2);
+
+  char text[48];
+  std::snprintf(text, sizeof(text), "%04lld-%02u-%02u %02d:%02d:%02d",
+                static_cast<long long>(year), month, day,
+                static_cast<int>(time_of_day / 3600),
+                static_cast<int>(time_of_day / 60 % 60),
+                static_cast<int>(time_of_day % 60));
+  return text;
+}
+
+/// @brief formats seconds since the epoch in the local time zone, which is
+/// how entries are shown
+/// @param seconds
+/// @return "YYYY-MM-DD HH:MM:SS", or an empty string for kUnknownTime
+std::string format_local_time(std::int64_t seconds) {
+  if (seconds == kUnknownTime) return "";
+
+  const std::time_t time = static_cast<std::time_t>(seconds);
+  std::tm fields;
+  if (!localtime_r(&time, &fields)) return "";
+
+  char text[32];
+  std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &fields);
+  return text;
+}
@@ -0,0 +1,16 @@
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/// @brief timestamp that could not be parsed
+inline constexpr std::int64_t kUnknownTime = INT64_MIN;
+
+std::int64_t parse_timestamp(std::string_view text);
+std::int64_t parse_local_timestamp(std::string_view text);
+std::string format_timestamp(std::int64_t seconds);
+std::string format_local_time(std::int64_t seconds);
+
+#endif
@@ -0,0 +1,48 @@
+#include "edit_dialog.hpp"
+
+/// @brief builds the dialog hidden, on top of the parent window
+/// @param parent
+/// @param on_save called with the entry, its name when opened and the name
+/// entered, when the user saves
+EditDialog::EditDialog(Gtk::Window& parent, SaveHandler on_save)
+    : m_onSave(std::move(on_save)),
+      m_vbox(Gtk::Orientation::VERTICAL, 10),
+      m_label("Enter new tea name:"),
+      m_hbox(Gtk::Orientation::HORIZONTAL, 10),
+      m_cancelButton("Cancel"),
+      m_saveButton("Save") {
+  set_title("Edit Tea Name");
+  set_default_size(300, 150);
+  set_transient_for(parent);
+  set_modal(true);
+  set_hide_on_close(true);
+
+  m_vbox.append(m_label);
+  m_vbox.append(m_entry);
+  m_hbox.append(m_cancelButton);
+  m_hbox.append(m_saveButton);
+  m_vbox.append(m_hbox);
+  set_child(m_vbox);
+
+  m_cancelButton.signal_clicked().connect([this] { hide(); });
+  m_saveButton.signal_clicked().connect(
+      sigc::mem_fun(*this, &EditDialog::on_save));
+  m_entry.signal_activate().connect(
+      sigc::mem_fun(*this, &EditDialog::on_save));
+}
+
+/// @brief binds the dialog to an entry and shows it
+/// @param tea_id
+/// @param tea_name
+void EditDialog::edit(int tea_id, const std::string& tea_name) {
+  m_teaId = tea_id;
+  m_teaName = tea_name;
+  m_entry.set_text(tea_name);
+  m_entry.grab_focus();
+  present();
+}
+
+void EditDialog::on_save() {
+  hide();
+  m_onSave(m_teaId, m_teaName, m_entry.get_text());
+}
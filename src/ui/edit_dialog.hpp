@@ -0,0 +1,40 @@
+#ifndef EDIT_DIALOG_HPP
+#define EDIT_DIALOG_HPP
+
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/label.h>
+#include <gtkmm/window.h>
+
+#include <functional>
+#include <string>
+
+/// @brief The window for renaming a log entry. One is created and kept for
+/// the life of the application; each edit rebinds it to the selected entry
+/// and shows it again, and closing only hides it.
+class EditDialog : public Gtk::Window {
+ public:
+  using SaveHandler = std::function<void(
+      int tea_id, const std::string& old_name, const std::string& new_name)>;
+
+  EditDialog(Gtk::Window& parent, SaveHandler on_save);
+
+  void edit(int tea_id, const std::string& tea_name);
+
+ private:
+  void on_save();
+
+  SaveHandler m_onSave;
+  int m_teaId = 0;
+  std::string m_teaName;
+
+  Gtk::Box m_vbox;
+  Gtk::Label m_label;
+  Gtk::Entry m_entry;
+  Gtk::Box m_hbox;
+  Gtk::Button m_cancelButton;
+  Gtk::Button m_saveButton;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "profile_page.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+/// @brief formats nanoseconds in the largest unit that keeps them readable
+static std::string format_duration(std::uint64_t nanoseconds) {
+  char text[32];
+  if (nanoseconds >= 1000000) {
+    std::snprintf(text, sizeof(text), "%.1f ms", nanoseconds / 1e6);
+  } else {
+    std::snprintf(text, sizeof(text), "%.1f us", nanoseconds / 1e3);
+  }
+  return text;
+}
+
+/// @brief builds every widget of the page, empty until shown
+/// @param on_export_snapshot called by the Export snapshot button
+/// @param on_export_trace called by the Export trace button
+ProfilePage::ProfilePage(std::function<void()> on_export_snapshot,
+                         std::function<void()> on_export_trace)
+    : Gtk::Box(Gtk::Orientation::VERTICAL, 10),
+      m_totals("", Gtk::Align::START),
+      m_streaks("", Gtk::Align::START),
+      m_content(Gtk::Orientation::VERTICAL, 10),
+      m_performanceButtons(Gtk::Orientation::HORIZONTAL, 6),
+      m_traceToggle("Record trace"),
+      m_snapshotButton("Export snapshot"),
+      m_traceButton("Export trace") {
+  append(m_totals);
+  append(m_streaks);
+
+  m_statisticsGrid.set_row_spacing(4);
+  m_statisticsGrid.set_column_spacing(10);
+  int row = attach_heading("Most logged", 0);
+  for (auto& [name, count] : m_topTeas) {
+    name = Gtk::make_managed<Gtk::Label>("", Gtk::Align::START);
+    count = Gtk::make_managed<Gtk::Label>("", Gtk::Align::END);
+    m_statisticsGrid.attach(*name, 0, row);
+    m_statisticsGrid.attach(*count, 2, row++);
+  }
+
+  row = attach_heading("By weekday", row);
+  const char* weekdays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  for (size_t day = 0; day < m_weekdays.size(); ++day) {
+    m_weekdays[day] = attach_bar(weekdays[day], row++);
+  }
+
+  row = attach_heading("By hour", row);
+  for (size_t hour = 0; hour < m_hours.size(); ++hour) {
+    m_hours[hour] = attach_bar(
+        (hour < 10 ? "0" : "") + std::to_string(hour) + ":00", row++);
+  }
+  m_content.append(m_statisticsGrid);
+
+  m_content.append(
+      *Gtk::make_managed<Gtk::Label>("Performance", Gtk::Align::START));
+  m_performanceGrid.set_row_spacing(2);
+  m_performanceGrid.set_column_spacing(12);
+  const char* headings[] = {"Operation", "Calls", "p50", "p99", "Max"};
+  for (int column = 0; column < 5; ++column) {
+    m_performanceGrid.attach(
+        *Gtk::make_managed<Gtk::Label>(
+            headings[column], column ? Gtk::Align::END : Gtk::Align::START),
+        column, 0);
+  }
+  m_content.append(m_performanceGrid);
+
+  m_traceToggle.signal_toggled().connect([this] {
+    Instrumentation::instance().set_tracing(m_traceToggle.get_active());
+  });
+  m_snapshotButton.signal_clicked().connect(std::move(on_export_snapshot));
+  m_traceButton.signal_clicked().connect(std::move(on_export_trace));
+  m_performanceButtons.append(m_traceToggle);
+  m_performanceButtons.append(m_snapshotButton);
+  m_performanceButtons.append(m_traceButton);
+  m_content.append(m_performanceButtons);
+
+  m_scrolledWindow.set_expand(true);
+  m_scrolledWindow.set_child(m_content);
+  append(m_scrolledWindow);
+}
+
+/// @brief refreshes the statistics section
+/// @param statistics
+void ProfilePage::show_statistics(const TeaStatistics& statistics) {
+  m_totals.set_text(std::to_string(statistics.total_entries) +
+                    " teas logged, " +
+                    std::to_string(statistics.distinct_teas) +
+                    " different teas, on " +
+                    std::to_string(statistics.days_logged) + " days");
+  m_streaks.set_text(
+      "Current streak: " + std::to_string(statistics.current_streak) +
+      " days, longest streak: " + std::to_string(statistics.longest_streak) +
+      " days");
+
+  for (size_t i = 0; i < m_topTeas.size(); ++i) {
+    auto [name, count] = m_topTeas[i];
+    const bool shown = i < statistics.top_teas.size();
+    name->set_visible(shown);
+    count->set_visible(shown);
+    if (shown) {
+      name->set_text(statistics.top_teas[i].tea_name);
+      count->set_text(std::to_string(statistics.top_teas[i].count));
+    }
+  }
+
+  show_distribution(m_weekdays, statistics.by_weekday);
+  show_distribution(m_hours, statistics.by_hour);
+}
+
+/// @brief refreshes the performance section with each timed operation and
+/// counter, adding rows only when there are more than ever before
+/// @param operations
+/// @param counters
+void ProfilePage::show_performance(
+    const std::vector<OperationSummary>& operations,
+    const std::map<std::string, std::uint64_t>& counters) {
+  m_traceToggle.set_active(Instrumentation::instance().tracing());
+
+  size_t index = 0;
+  for (const OperationSummary& operation : operations) {
+    PerformanceRow& row = performance_row(index++);
+    row[0]->set_text(operation.name);
+    row[0]->set_tooltip_text(operation.name);
+    row[1]->set_text(std::to_string(operation.count));
+    row[2]->set_text(format_duration(operation.p50));
+    row[3]->set_text(format_duration(operation.p99));
+    row[4]->set_text(format_duration(operation.max));
+  }
+  for (const auto& [counter, value] : counters) {
+    PerformanceRow& row = performance_row(index++);
+    row[0]->set_text(counter);
+    row[0]->set_tooltip_text(counter);
+    row[1]->set_text(std::to_string(value));
+    for (size_t column = 2; column < row.size(); ++column) {
+      row[column]->set_text("");
+    }
+  }
+
+  for (size_t i = 0; i < m_performanceRows.size(); ++i) {
+    for (Gtk::Label* cell : m_performanceRows[i]) {
+      cell->set_visible(i < index);
+    }
+  }
+}
+
+/// @brief adds a heading spanning the statistics grid
+/// @return the next free grid row
+int ProfilePage::attach_heading(const std::string& text, int row) {
+  m_statisticsGrid.attach(
+      *Gtk::make_managed<Gtk::Label>(text, Gtk::Align::START), 0, row, 3);
+  return row + 1;
+}
+
+/// @brief adds a labelled bar with its count to the statistics grid
+ProfilePage::BarRow ProfilePage::attach_bar(const std::string& text,
+                                            int row) {
+  BarRow bar_row{Gtk::make_managed<Gtk::Label>(text, Gtk::Align::START),
+                 Gtk::make_managed<Gtk::LevelBar>(),
+                 Gtk::make_managed<Gtk::Label>("0", Gtk::Align::END)};
+  bar_row.bar->set_min_value(0);
+  bar_row.bar->set_hexpand(true);
+  m_statisticsGrid.attach(*bar_row.label, 0, row);
+  m_statisticsGrid.attach(*bar_row.bar, 1, row);
+  m_statisticsGrid.attach(*bar_row.count, 2, row);
+  return bar_row;
+}
+
+/// @brief sets a group of bars, each scaled against the largest value
+/// @param rows
+/// @param values
+template <size_t N>
+void ProfilePage::show_distribution(std::array<BarRow, N>& rows,
+                                    const std::array<size_t, N>& values) {
+  size_t largest = 1;
+  for (size_t value : values) largest = std::max(largest, value);
+
+  for (size_t i = 0; i < N; ++i) {
+    rows[i].bar->set_max_value(static_cast<double>(largest));
+    rows[i].bar->set_value(static_cast<double>(values[i]));
+    rows[i].count->set_text(std::to_string(values[i]));
+  }
+}
+
+/// @brief the labels of a performance row, created on first use
+/// @param index
+ProfilePage::PerformanceRow& ProfilePage::performance_row(size_t index) {
+  while (m_performanceRows.size() <= index) {
+    const int grid_row = static_cast<int>(m_performanceRows.size()) + 1;
+    PerformanceRow row;
+    for (size_t column = 0; column < row.size(); ++column) {
+      row[column] = Gtk::make_managed<Gtk::Label>(
+          "", column ? Gtk::Align::END : Gtk::Align::START);
+      m_performanceGrid.attach(*row[column], static_cast<int>(column),
+                               grid_row);
+    }
+    row[0]->set_ellipsize(Pango::EllipsizeMode::END);
+    row[0]->set_max_width_chars(48);
+    m_performanceRows.push_back(row);
+  }
+  return m_performanceRows[index];
+}
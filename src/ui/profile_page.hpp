@@ -0,0 +1,70 @@
+#ifndef PROFILE_PAGE_HPP
+#define PROFILE_PAGE_HPP
+
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/checkbutton.h>
+#include <gtkmm/grid.h>
+#include <gtkmm/label.h>
+#include <gtkmm/levelbar.h>
+#include <gtkmm/scrolledwindow.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../db/tea_statistics.hpp"
+#include "../utility/instrumentation.hpp"
+
+/// @brief The profile page: statistics about the log and where time has
+/// gone. Its widgets are created once and refreshed in place each time the
+/// page is shown; only performance rows for newly seen operations are
+/// added.
+class ProfilePage : public Gtk::Box {
+ public:
+  ProfilePage(std::function<void()> on_export_snapshot,
+              std::function<void()> on_export_trace);
+
+  void show_statistics(const TeaStatistics& statistics);
+  void show_performance(const std::vector<OperationSummary>& operations,
+                        const std::map<std::string, std::uint64_t>& counters);
+
+ private:
+  static constexpr size_t kTopTeas = 10;
+
+  struct BarRow {
+    Gtk::Label* label;
+    Gtk::LevelBar* bar;
+    Gtk::Label* count;
+  };
+  using PerformanceRow = std::array<Gtk::Label*, 5>;
+
+  int attach_heading(const std::string& text, int row);
+  BarRow attach_bar(const std::string& text, int row);
+  template <size_t N>
+  static void show_distribution(std::array<BarRow, N>& rows,
+                                const std::array<size_t, N>& values);
+  PerformanceRow& performance_row(size_t index);
+
+  Gtk::Label m_totals;
+  Gtk::Label m_streaks;
+  Gtk::ScrolledWindow m_scrolledWindow;
+  Gtk::Box m_content;
+
+  Gtk::Grid m_statisticsGrid;
+  std::array<std::pair<Gtk::Label*, Gtk::Label*>, kTopTeas> m_topTeas;
+  std::array<BarRow, 7> m_weekdays;
+  std::array<BarRow, 24> m_hours;
+
+  Gtk::Grid m_performanceGrid;
+  std::vector<PerformanceRow> m_performanceRows;
+  Gtk::Box m_performanceButtons;
+  Gtk::CheckButton m_traceToggle;
+  Gtk::Button m_snapshotButton;
+  Gtk::Button m_traceButton;
+};
+
+#endif
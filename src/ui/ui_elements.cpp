@@ -1,14 +1,20 @@
 #include "ui_elements.hpp"
 
+#include <string>
+
+#include "../models/timestamp.hpp"
+#include "../utility/utility.hpp"
+
 /// @brief default constructor
 UiElements::UiElements() {}
 
 Gtk::Box* UiElements::create_tea_content(Gtk::Entry& entry,
                                          Gtk::SearchEntry& searchEntry,
+                                         Gtk::Label& searchNote,
                                          Gtk::Button& logButton,
                                          Gtk::Button& deleteButton,
                                          Gtk::Button& editButton,
-                                         Gtk::TreeView& treeView) {
+                                         Gtk::ColumnView& columnView) {
   auto main_content =
       Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL, 10);
 
@@ -18,9 +24,13 @@ Gtk::Box* UiElements::create_tea_content(Gtk::Entry& entry,
   deleteButton.set_label("Delete Tea");
   editButton.set_label("Edit tea");
   searchEntry.set_placeholder_text("Search tea...");
+  searchNote.set_wrap(true);
+  searchNote.get_style_context()->add_class("search-note");
+  searchNote.set_visible(false);
 
   sidebar->append(entry);
   sidebar->append(searchEntry);
+  sidebar->append(searchNote);
   sidebar->append(logButton);
   sidebar->append(deleteButton);
   sidebar->append(editButton);
@@ -29,7 +39,7 @@ Gtk::Box* UiElements::create_tea_content(Gtk::Entry& entry,
 
   auto scrolledWindow = Gtk::make_managed<Gtk::ScrolledWindow>();
   scrolledWindow->set_expand(true);
-  scrolledWindow->set_child(treeView);
+  scrolledWindow->set_child(columnView);
 
   main_content->append(*scrolledWindow);
 
@@ -42,7 +52,7 @@ Gtk::Box* UiElements::create_tea_content(Gtk::Entry& entry,
 /// @param main_content
 /// @return a pointer to the created main box
 Gtk::Box* UiElements::create_main_box(Gtk::Box* side_panel,
-                                      Gtk::Box* main_content) {
+                                      Gtk::Widget* main_content) {
   auto main_box = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL, 10);
   main_box->set_margin(10);
   main_box->set_hexpand(true);
@@ -55,67 +65,35 @@ Gtk::Box* UiElements::create_main_box(Gtk::Box* side_panel,
   return main_box;
 }
 
-/// @brief sets up the tree view with columns and the refmodel
-/// @param treeView
-/// @param refTreeModel
-/// @param colID
-/// @param colName
-/// @param colLocal
-/// @param colUtc
-void UiElements::setup_treeview(Gtk::TreeView& treeView,
-                                Glib::RefPtr<Gtk::ListStore>& refTreeModel,
-                                Gtk::TreeModelColumn<int>& colID,
-                                Gtk::TreeModelColumn<std::string>& colName,
-                                Gtk::TreeModelColumn<std::string>& colLocal,
-                                Gtk::TreeModelColumn<std::string>& colUtc) {
-  m_Columns.add(colID);
-  m_Columns.add(colName);
-  m_Columns.add(colLocal);
-  m_Columns.add(colUtc);
-
-  refTreeModel = Gtk::ListStore::create(m_Columns);
-
-  treeView.set_model(refTreeModel);
-
-  treeView.append_column("ID", colID);
-  treeView.append_column("Name", colName);
-  treeView.append_column("Local Time", colLocal);
-  treeView.append_column("UTC Time", colUtc);
-}
-
-Gtk::Window* UiElements::create_edit_window(
-    const std::string& tea_name,
-    std::function<void(const std::string&)> on_save) {
-  auto edit_window = Gtk::make_managed<Gtk::Window>();
-  edit_window->set_title("Edit Tea Name");
-  edit_window->set_default_size(300, 150);
-
-  auto vbox = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 10);
-  edit_window->set_child(*vbox);
-
-  auto label = Gtk::make_managed<Gtk::Label>("Enter new tea name:");
-  vbox->append(*label);
-
-  auto entry = Gtk::make_managed<Gtk::Entry>();
-  entry->set_text(tea_name);
-  vbox->append(*entry);
-
-  auto hbox = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL, 10);
-  vbox->append(*hbox);
-
-  auto cancel_button = Gtk::make_managed<Gtk::Button>("Cancel");
-  cancel_button->signal_clicked().connect(
-      [edit_window]() { edit_window->hide(); });
-  hbox->append(*cancel_button);
-
-  auto save_button = Gtk::make_managed<Gtk::Button>("Save");
-  save_button->signal_clicked().connect([on_save, entry, edit_window]() {
-    on_save(entry->get_text());
-    edit_window->hide();
-  });
-  hbox->append(*save_button);
-
-  return edit_window;
+/// @brief sets up the column view with columns over the tea list model
+/// @param columnView
+/// @param teaList
+/// @param selection
+void UiElements::setup_columnview(
+    Gtk::ColumnView& columnView, const Glib::RefPtr<TeaListModel>& teaList,
+    Glib::RefPtr<Gtk::SingleSelection>& selection) {
+  selection = Gtk::SingleSelection::create(teaList);
+  selection->set_autoselect(false);
+  selection->set_can_unselect(true);
+
+  columnView.set_model(selection);
+
+  columnView.append_column(Gtk::ColumnViewColumn::create(
+      "ID", Utility::CreateLabelFactory([](const TeaLogEntry& entry) {
+        return std::to_string(entry.id);
+      })));
+  columnView.append_column(Gtk::ColumnViewColumn::create(
+      "Name", Utility::CreateLabelFactory([](const TeaLogEntry& entry) {
+        return entry.tea_name;
+      })));
+  columnView.append_column(Gtk::ColumnViewColumn::create(
+      "Local Time", Utility::CreateLabelFactory([](const TeaLogEntry& entry) {
+        return format_local_time(entry.logged_at);
+      })));
+  columnView.append_column(Gtk::ColumnViewColumn::create(
+      "UTC Time", Utility::CreateLabelFactory([](const TeaLogEntry& entry) {
+        return format_timestamp(entry.logged_at);
+      })));
 }
 
 Gtk::Box* UiElements::create_side_panel(Gtk::Button& profileButton,
@@ -150,11 +128,3 @@ void UiElements::toggle_side_panel(Gtk::Box& side_panel,
   }
   is_expanded = !is_expanded;
 }
-
-Gtk::Box* UiElements::create_profile_content() {
-  auto profile_content =
-      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL);
-  auto label = Gtk::make_managed<Gtk::Label>("This is a test profile content.");
-  profile_content->append(*label);
-  return profile_content;
-}
\ No newline at end of file
@@ -4,24 +4,25 @@
 #include <glibmm.h>
 #include <gtkmm/box.h>
 #include <gtkmm/button.h>
+#include <gtkmm/columnview.h>
 #include <gtkmm/entry.h>
 #include <gtkmm/image.h>
 #include <gtkmm/label.h>
-#include <gtkmm/liststore.h>
 #include <gtkmm/scrolledwindow.h>
 #include <gtkmm/searchentry.h>
-#include <gtkmm/treeview.h>
+#include <gtkmm/singleselection.h>
 #include <gtkmm/window.h>
 
+#include <string>
+
 #include "../models/tea.hpp"
+#include "../models/tea_list_model.hpp"
 
 /// @brief class for creating and managing ui elements
 class UiElements {
  public:
   UiElements();
 
-  Gtk::Box* create_profile_content();
-
   void toggle_side_panel(Gtk::Box& side_panel, Gtk::Button& toggle_button,
                          bool& is_expanded);
 
@@ -30,30 +31,16 @@ class UiElements {
                               Gtk::Button& toggleButton);
 
   Gtk::Box* create_tea_content(Gtk::Entry& entry, Gtk::SearchEntry& searchEntry,
-                               Gtk::Button& logButton,
+                               Gtk::Label& searchNote, Gtk::Button& logButton,
                                Gtk::Button& deleteButton,
                                Gtk::Button& editButton,
-                               Gtk::TreeView& treeView);
-
-  Gtk::Box* create_main_box(Gtk::Box* side_panel, Gtk::Box* main_content);
-
-  Gtk::Window* create_edit_window(
-      const std::string& tea_name,
-      std::function<void(const std::string&)> on_save);
-
-  void setup_treeview(Gtk::TreeView& treeView,
-                      Glib::RefPtr<Gtk::ListStore>& refTreeModel,
-                      Gtk::TreeModelColumn<int>& colID,
-                      Gtk::TreeModelColumn<std::string>& colName,
-                      Gtk::TreeModelColumn<std::string>& colLocal,
-                      Gtk::TreeModelColumn<std::string>& colUtc);
-
- private:
-  Gtk::TreeModelColumn<int> m_colID;
-  Gtk::TreeModelColumn<std::string> m_colName;
-  Gtk::TreeModelColumn<std::string> m_colLocal;
-  Gtk::TreeModelColumn<std::string> m_colUtc;
-  Gtk::TreeModelColumnRecord m_Columns;
+                               Gtk::ColumnView& columnView);
+
+  Gtk::Box* create_main_box(Gtk::Box* side_panel, Gtk::Widget* main_content);
+
+  void setup_columnview(Gtk::ColumnView& columnView,
+                        const Glib::RefPtr<TeaListModel>& teaList,
+                        Glib::RefPtr<Gtk::SingleSelection>& selection);
 };
 
 #endif
@@ -1,9 +1,11 @@
 #include "ui_style.hpp"
 
-/// @brief injects css into the layout
+/// @brief injects css into the layout; the stylesheet is compiled into the
+/// binary as a GResource, so it loads without touching the disk and no
+/// longer depends on the working directory
 void UiStyle::initialize_styling() {
   Glib::RefPtr<Gtk::CssProvider> css_provider = Gtk::CssProvider::create();
-  css_provider->load_from_path("src/style.css");
+  css_provider->load_from_resource("/tea/logger/style.css");
   Glib::RefPtr<Gdk::Display> display = Gdk::Display::get_default();
   Gtk::StyleContext::add_provider_for_display(
       display, css_provider, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
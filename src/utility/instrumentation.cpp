@@ -0,0 +1,266 @@
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+/// @brief writes text as a JSON string
+static void write_json_string(std::ostream& output, std::string_view text) {
+  output << '"';
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        output << "\\\"";
+        break;
+      case '\\':
+        output << "\\\\";
+        break;
+      case '\n':
+        output << "\\n";
+        break;
+      case '\t':
+        output << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          output << escaped;
+        } else {
+          output << c;
+        }
+    }
+  }
+  output << '"';
+}
+
+/// @brief small id of the calling thread, stable for its lifetime
+static unsigned thread_number() {
+  static std::atomic<unsigned> next{1};
+  thread_local const unsigned number = next++;
+  return number;
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds) {
+  const int bucket =
+      nanoseconds ? 63 - __builtin_clzll(nanoseconds) : 0;  // floor(log2)
+  ++m_buckets[bucket];
+  ++m_count;
+  m_total += nanoseconds;
+  m_min = std::min(m_min, nanoseconds);
+  m_max = std::max(m_max, nanoseconds);
+}
+
+/// @brief estimates a percentile as the upper end of the bucket it falls
+/// in, clamped to the largest duration seen
+/// @param fraction between 0 and 1
+std::uint64_t LatencyHistogram::percentile(double fraction) const {
+  if (m_count == 0) return 0;
+  const auto rank = static_cast<std::uint64_t>(fraction * (m_count - 1)) + 1;
+  std::uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < m_buckets.size(); ++bucket) {
+    seen += m_buckets[bucket];
+    if (seen >= rank) {
+      const std::uint64_t upper =
+          bucket >= 63 ? UINT64_MAX : (std::uint64_t{2} << bucket) - 1;
+      return std::min(upper, m_max);
+    }
+  }
+  return m_max;
+}
+
+Instrumentation::Instrumentation() : m_epoch(Clock::now()) {}
+
+Instrumentation& Instrumentation::instance() {
+  static Instrumentation instrumentation;
+  return instrumentation;
+}
+
+/// @brief records one timed occurrence of an operation
+/// @param operation
+/// @param start
+/// @param duration
+void Instrumentation::record(std::string_view operation,
+                             Clock::time_point start,
+                             Clock::duration duration) {
+  const auto nanoseconds = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto histogram = m_operations.find(operation);
+  if (histogram == m_operations.end()) {
+    histogram =
+        m_operations.emplace(std::string(operation), LatencyHistogram()).first;
+  }
+  histogram->second.record(nanoseconds);
+
+  if (tracing()) {
+    if (m_events.size() >= m_maxEvents) m_events.pop_front();
+    m_events.push_back(
+        {std::string(operation),
+         static_cast<std::uint64_t>(
+             std::chrono::duration_cast<std::chrono::microseconds>(start -
+                                                                   m_epoch)
+                 .count()),
+         nanoseconds / 1000, thread_number()});
+  }
+}
+
+/// @brief adds to a named counter
+/// @param counter
+/// @param amount
+void Instrumentation::count(std::string_view counter, std::uint64_t amount) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto known = m_counters.find(counter);
+  if (known == m_counters.end()) {
+    m_counters.emplace(std::string(counter), amount);
+  } else {
+    known->second += amount;
+  }
+}
+
+/// @brief starts or stops keeping individual events for a trace. The
+/// oldest events are dropped once max_events are held.
+/// @param enabled
+/// @param max_events
+void Instrumentation::set_tracing(bool enabled, size_t max_events) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_maxEvents = max_events;
+  while (m_events.size() > m_maxEvents) m_events.pop_front();
+  m_tracing.store(enabled && max_events > 0, std::memory_order_relaxed);
+}
+
+std::vector<OperationSummary> Instrumentation::operations() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<OperationSummary> summaries;
+  for (const auto& [name, histogram] : m_operations) {
+    summaries.push_back({name, histogram.count(), histogram.total(),
+                         histogram.min(), histogram.percentile(0.5),
+                         histogram.percentile(0.9), histogram.percentile(0.99),
+                         histogram.max()});
+  }
+  return summaries;
+}
+
+std::map<std::string, std::uint64_t> Instrumentation::counters() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return {m_counters.begin(), m_counters.end()};
+}
+
+/// @brief writes every operation's timings and every counter as one JSON
+/// object, durations in nanoseconds
+/// @param output
+void Instrumentation::write_snapshot(std::ostream& output) const {
+  output << "{\"operations\":{";
+  bool first = true;
+  for (const OperationSummary& operation : operations()) {
+    if (!first) output << ',';
+    first = false;
+    write_json_string(output, operation.name);
+    output << ":{\"count\":" << operation.count
+           << ",\"total_ns\":" << operation.total
+           << ",\"min_ns\":" << operation.min
+           << ",\"p50_ns\":" << operation.p50
+           << ",\"p90_ns\":" << operation.p90
+           << ",\"p99_ns\":" << operation.p99
+           << ",\"max_ns\":" << operation.max << '}';
+  }
+  output << "},\"counters\":{";
+  first = true;
+  for (const auto& [name, value] : counters()) {
+    if (!first) output << ',';
+    first = false;
+    write_json_string(output, name);
+    output << ':' << value;
+  }
+  output << "}}\n";
+}
+
+/// @brief writes the traced events as complete ("X") events of the Chrome
+/// trace-event format
+/// @param output
+void Instrumentation::write_chrome_trace(std::ostream& output) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  output << "{\"traceEvents\":[";
+  bool first = true;
+  for (const TraceEvent& event : m_events) {
+    output << (first ? "\n" : ",\n");
+    first = false;
+    output << "{\"name\":";
+    write_json_string(output, event.name);
+    output << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+           << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us
+           << '}';
+  }
+  output << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Instrumentation::reset() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_operations.clear();
+  m_counters.clear();
+  m_events.clear();
+}
+
+/// @param start the time milestones are measured from, normally taken as
+/// main is entered
+StartupTimeline::StartupTimeline(Instrumentation::Clock::time_point start)
+    : m_start(start) {}
+
+/// @brief records that startup has reached a milestone; a milestone marked
+/// again keeps its first time
+/// @param milestone
+void StartupTimeline::mark(std::string_view milestone) {
+  for (const Milestone& reached : m_milestones) {
+    if (reached.name == milestone) return;
+  }
+  const auto elapsed = Instrumentation::Clock::now() - m_start;
+  Instrumentation::instance().record("startup." + std::string(milestone),
+                                     m_start, elapsed);
+  m_milestones.push_back({std::string(milestone), elapsed});
+}
+
+/// @brief writes one line per milestone reached, in the order reached, with
+/// the time since the start and since the milestone before it
+void StartupTimeline::write_report(std::ostream& output) const {
+  auto milliseconds = [](Instrumentation::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  };
+  output << "startup report (ms since start, ms since previous)\n";
+  Instrumentation::Clock::duration previous{};
+  for (const Milestone& reached : m_milestones) {
+    char line[128];
+    std::snprintf(line, sizeof line, "  %-24s %9.1f %9.1f\n",
+                  reached.name.c_str(), milliseconds(reached.elapsed),
+                  milliseconds(reached.elapsed - previous));
+    output << line;
+    previous = reached.elapsed;
+  }
+}
+
+/// @brief turns tracing on when TEA_LOGGER_TRACE is set to something other
+/// than 0
+void configure_instrumentation_from_environment() {
+  const char* trace = std::getenv("TEA_LOGGER_TRACE");
+  if (trace && *trace && std::string_view(trace) != "0") {
+    Instrumentation::instance().set_tracing(true);
+  }
+}
+
+/// @brief whether TEA_LOGGER_STARTUP_REPORT is set to something other than 0
+bool startup_report_requested_from_environment() {
+  const char* report = std::getenv("TEA_LOGGER_STARTUP_REPORT");
+  return report && *report && std::string_view(report) != "0";
+}
+
+/// @brief the slow statement threshold set by TEA_LOGGER_SLOW_SQL_MS
+/// @return microseconds, or -1 if statements are not traced
+std::int64_t slow_statement_threshold_from_environment() {
+  const char* milliseconds = std::getenv("TEA_LOGGER_SLOW_SQL_MS");
+  if (!milliseconds || !*milliseconds) return -1;
+  char* end = nullptr;
+  const double value = std::strtod(milliseconds, &end);
+  if (*end != '\0' || value < 0) return -1;
+  return static_cast<std::int64_t>(value * 1000);
+}
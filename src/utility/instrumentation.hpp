@@ -0,0 +1,135 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief durations of one operation, counted in power-of-two buckets of
+/// nanoseconds so recording is constant time and memory
+class LatencyHistogram {
+ public:
+  void record(std::uint64_t nanoseconds);
+
+  std::uint64_t count() const { return m_count; }
+  std::uint64_t total() const { return m_total; }
+  std::uint64_t min() const { return m_count ? m_min : 0; }
+  std::uint64_t max() const { return m_max; }
+  std::uint64_t percentile(double fraction) const;
+
+ private:
+  std::array<std::uint64_t, 64> m_buckets{};
+  std::uint64_t m_count = 0;
+  std::uint64_t m_total = 0;
+  std::uint64_t m_min = UINT64_MAX;
+  std::uint64_t m_max = 0;
+};
+
+/// @brief timings of one operation, in nanoseconds
+struct OperationSummary {
+  std::string name;
+  std::uint64_t count;
+  std::uint64_t total;
+  std::uint64_t min;
+  std::uint64_t p50;
+  std::uint64_t p90;
+  std::uint64_t p99;
+  std::uint64_t max;
+};
+
+/// @brief Process-wide record of where time goes: a histogram of durations
+/// per operation, named counters such as rows returned, and, while tracing
+/// is on, a bounded buffer of individual timed events. Everything can be
+/// written out as a JSON snapshot, or the events as a Chrome trace-event
+/// file for chrome://tracing or Perfetto. Safe to use from any thread.
+class Instrumentation {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static Instrumentation& instance();
+
+  void record(std::string_view operation, Clock::time_point start,
+              Clock::duration duration);
+  void count(std::string_view counter, std::uint64_t amount = 1);
+
+  void set_tracing(bool enabled, size_t max_events = 100000);
+  bool tracing() const { return m_tracing.load(std::memory_order_relaxed); }
+
+  std::vector<OperationSummary> operations() const;
+  std::map<std::string, std::uint64_t> counters() const;
+  void write_snapshot(std::ostream& output) const;
+  void write_chrome_trace(std::ostream& output) const;
+  void reset();
+
+ private:
+  struct TraceEvent {
+    std::string name;
+    std::uint64_t start_us;
+    std::uint64_t duration_us;
+    unsigned thread;
+  };
+
+  Instrumentation();
+
+  mutable std::mutex m_mutex;
+  std::map<std::string, LatencyHistogram, std::less<>> m_operations;
+  std::map<std::string, std::uint64_t, std::less<>> m_counters;
+  std::atomic<bool> m_tracing{false};
+  size_t m_maxEvents = 0;
+  std::deque<TraceEvent> m_events;
+  Clock::time_point m_epoch;
+};
+
+/// @brief times the enclosing scope as one occurrence of an operation
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(std::string_view operation)
+      : m_operation(operation), m_start(Instrumentation::Clock::now()) {}
+  ~ScopedTimer() {
+    Instrumentation::instance().record(
+        m_operation, m_start, Instrumentation::Clock::now() - m_start);
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  std::string_view m_operation;
+  Instrumentation::Clock::time_point m_start;
+};
+
+/// @brief Milestones of one startup, each timed from when main was entered.
+/// Every milestone is recorded as a "startup.<milestone>" operation, and the
+/// whole timeline can be written out as a report so time to interactive can
+/// be compared between builds.
+class StartupTimeline {
+ public:
+  explicit StartupTimeline(
+      Instrumentation::Clock::time_point start = Instrumentation::Clock::now());
+
+  void mark(std::string_view milestone);
+  void write_report(std::ostream& output) const;
+
+ private:
+  struct Milestone {
+    std::string name;
+    Instrumentation::Clock::duration elapsed;
+  };
+
+  Instrumentation::Clock::time_point m_start;
+  std::vector<Milestone> m_milestones;
+};
+
+void configure_instrumentation_from_environment();
+bool startup_report_requested_from_environment();
+std::int64_t slow_statement_threshold_from_environment();
+
+#endif
@@ -0,0 +1,147 @@
+#include "search_worker.hpp"
+
+#include <iostream>
+
+#include "instrumentation.hpp"
+
+/// @brief starts the worker thread. Must be constructed on the GTK main
+/// thread, which receives the results.
+/// @param pool leases the readers queries run on; must outlive the worker
+/// @param on_results called on the main thread with the latest results
+/// @param debounce quiet period after a keystroke before querying
+SearchWorker::SearchWorker(ConnectionPool& pool,
+                           ResultHandler on_results,
+                           std::chrono::milliseconds debounce)
+    : m_pool(pool),
+      m_onResults(std::move(on_results)),
+      m_debounce(debounce) {
+  m_dispatcher.connect(sigc::mem_fun(*this, &SearchWorker::on_dispatch));
+  m_thread = std::thread(&SearchWorker::run, this);
+}
+
+SearchWorker::~SearchWorker() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+    if (m_reader) m_reader->interrupt();
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+/// @brief queues a search, superseding and interrupting any earlier one
+/// @param search_term
+void SearchWorker::search(const std::string& search_term) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    m_pendingTerm = search_term;
+    m_hasPending = true;
+    if (m_reader) m_reader->interrupt();
+  }
+  m_wake.notify_all();
+}
+
+/// @brief drops any pending or running search without delivering results
+void SearchWorker::cancel() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_generation;
+  m_hasPending = false;
+  m_hasResult = false;
+  if (m_reader) m_reader->interrupt();
+}
+
+/// @brief whether a search is waiting, running or not yet delivered
+bool SearchWorker::busy() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hasPending || m_querying || m_hasResult;
+}
+
+void SearchWorker::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_wake.wait(lock, [this] { return m_stopping || m_hasPending; });
+    if (m_stopping) return;
+
+    // wait until typing pauses for the debounce interval
+    std::uint64_t generation = m_generation;
+    while (m_wake.wait_for(lock, m_debounce, [this, generation] {
+      return m_stopping || m_generation != generation;
+    })) {
+      if (m_stopping) return;
+      generation = m_generation;
+    }
+    if (!m_hasPending) continue;
+
+    const std::string search_term = m_pendingTerm;
+    m_hasPending = false;
+    m_querying = true;
+    lock.unlock();
+
+    CompactTeaLog results;
+    bool similar = false;
+    bool success = true;
+    try {
+      ScopedTimer timer("search_worker.query");
+      ConnectionPool::Lease reader = m_pool.reader();
+      {
+        std::lock_guard<std::mutex> active(m_mutex);
+        // a newer search may have arrived while waiting for the reader
+        success = generation == m_generation && !m_stopping;
+        if (success) m_reader = &*reader;
+      }
+      if (success) {
+        struct ClearReader {
+          SearchWorker* worker;
+          ~ClearReader() {
+            std::lock_guard<std::mutex> active(worker->m_mutex);
+            worker->m_reader = nullptr;
+          }
+        } clear_reader{this};
+        auto append = [&results](const TeaLogRow& row) { results.append(row); };
+        reader->find_tea_entries(search_term, append);
+        if (results.empty() && !search_term.empty()) {
+          similar = true;
+          reader->find_similar_entries(search_term, append);
+        }
+      }
+    } catch (const std::exception& e) {
+      success = false;
+      std::lock_guard<std::mutex> check(m_mutex);
+      if (generation == m_generation && !m_stopping) {
+        std::cerr << "Error executing database query: " << e.what()
+                  << std::endl;
+      }
+    }
+
+    lock.lock();
+    m_querying = false;
+    if (success && generation == m_generation) {
+      m_hasResult = true;
+      m_resultGeneration = generation;
+      m_resultTerm = search_term;
+      m_results = std::move(results);
+      m_resultSimilar = similar;
+      m_dispatcher.emit();
+    }
+  }
+}
+
+/// @brief delivers the results on the main thread if no newer search has been
+/// requested since they were produced
+void SearchWorker::on_dispatch() {
+  std::string search_term;
+  CompactTeaLog results;
+  bool similar;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_hasResult) return;
+    m_hasResult = false;
+    if (m_resultGeneration != m_generation) return;
+    search_term = std::move(m_resultTerm);
+    results = std::move(m_results);
+    m_results.clear();
+    similar = m_resultSimilar;
+  }
+  m_onResults(search_term, results, similar);
+}
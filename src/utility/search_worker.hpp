@@ -0,0 +1,70 @@
+#ifndef SEARCH_WORKER_HPP
+#define SEARCH_WORKER_HPP
+
+#include <glibmm/dispatcher.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../db/connection_pool.hpp"
+#include "../db/db_handler.hpp"
+#include "../models/compact_tea_log.hpp"
+
+/// @brief Runs tea searches on a background thread, leasing a read-only
+/// connection from the pool for each query. Requests are debounced, a newer
+/// request interrupts the query in flight, and only the results of the latest
+/// request are delivered back on the GTK main loop. A term no name contains
+/// is answered with the entries of the teas with similar names instead,
+/// flagged as such so the caller can say so.
+class SearchWorker {
+ public:
+  using ResultHandler = std::function<void(
+      const std::string& search_term, CompactTeaLog& entries, bool similar)>;
+
+  SearchWorker(ConnectionPool& pool, ResultHandler on_results,
+               std::chrono::milliseconds debounce =
+                   std::chrono::milliseconds(120));
+  ~SearchWorker();
+
+  SearchWorker(const SearchWorker&) = delete;
+  SearchWorker& operator=(const SearchWorker&) = delete;
+
+  void search(const std::string& search_term);
+  void cancel();
+  bool busy() const;
+
+ private:
+  void run();
+  void on_dispatch();
+
+  ConnectionPool& m_pool;
+  ResultHandler m_onResults;
+  std::chrono::milliseconds m_debounce;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stopping = false;
+  bool m_hasPending = false;
+  bool m_querying = false;
+  // the reader running the current query, for interrupting it
+  TeaDatabase* m_reader = nullptr;
+  std::uint64_t m_generation = 0;
+  std::string m_pendingTerm;
+
+  bool m_hasResult = false;
+  std::uint64_t m_resultGeneration = 0;
+  std::string m_resultTerm;
+  CompactTeaLog m_results;
+  bool m_resultSimilar = false;
+
+  Glib::Dispatcher m_dispatcher;
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "substring_matcher.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TEA_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static inline bool is_ascii_letter(unsigned char c) {
+  return static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+}
+
+static inline unsigned char fold(unsigned char c) {
+  return is_ascii_letter(c) ? c | 0x20 : c;
+}
+
+/// @brief compares text against the lower-cased term
+static inline bool equals_folded(const char* text, const char* term,
+                                 size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (fold(static_cast<unsigned char>(text[i])) !=
+        static_cast<unsigned char>(term[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static size_t find_scalar(std::string_view text, std::string_view term,
+                          size_t from) {
+  const unsigned char first = static_cast<unsigned char>(term[0]);
+  for (size_t i = from; i + term.size() <= text.size(); ++i) {
+    if (fold(static_cast<unsigned char>(text[i])) == first &&
+        equals_folded(text.data() + i + 1, term.data() + 1,
+                      term.size() - 1)) {
+      return i;
+    }
+  }
+  return std::string_view::npos;
+}
+
+#ifdef TEA_X86_SIMD
+// a byte b matches a lower-cased letter c when (b | 0x20) == c, which holds
+// for exactly the two cases of c; other bytes must match exactly, so their
+// mask is 0
+static inline char fold_mask(char c) {
+  return is_ascii_letter(static_cast<unsigned char>(c)) ? 0x20 : 0;
+}
+
+__attribute__((target("sse4.2"))) static size_t find_sse42(
+    std::string_view text, std::string_view term, size_t from) {
+  const size_t last = term.size() - 1;
+  const __m128i first_byte = _mm_set1_epi8(term[0]);
+  const __m128i last_byte = _mm_set1_epi8(term[last]);
+  const __m128i first_mask = _mm_set1_epi8(fold_mask(term[0]));
+  const __m128i last_mask = _mm_set1_epi8(fold_mask(term[last]));
+
+  size_t i = from;
+  for (; i + last + 16 <= text.size(); i += 16) {
+    const __m128i firsts = _mm_or_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i)),
+        first_mask);
+    const __m128i lasts = _mm_or_si128(
+        _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(text.data() + i + last)),
+        last_mask);
+    unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(firsts, first_byte),
+                      _mm_cmpeq_epi8(lasts, last_byte))));
+    while (bits) {
+      const size_t position = i + __builtin_ctz(bits);
+      if (last < 2 || equals_folded(text.data() + position + 1,
+                                    term.data() + 1, last - 1)) {
+        return position;
+      }
+      bits &= bits - 1;
+    }
+  }
+  return find_scalar(text, term, i);
+}
+
+__attribute__((target("avx2"))) static size_t find_avx2(
+    std::string_view text, std::string_view term, size_t from) {
+  const size_t last = term.size() - 1;
+  const __m256i first_byte = _mm256_set1_epi8(term[0]);
+  const __m256i last_byte = _mm256_set1_epi8(term[last]);
+  const __m256i first_mask = _mm256_set1_epi8(fold_mask(term[0]));
+  const __m256i last_mask = _mm256_set1_epi8(fold_mask(term[last]));
+
+  size_t i = from;
+  for (; i + last + 32 <= text.size(); i += 32) {
+    const __m256i firsts = _mm256_or_si256(
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(text.data() + i)),
+        first_mask);
+    const __m256i lasts = _mm256_or_si256(
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(text.data() + i + last)),
+        last_mask);
+    unsigned bits = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(firsts, first_byte),
+                         _mm256_cmpeq_epi8(lasts, last_byte))));
+    while (bits) {
+      const size_t position = i + __builtin_ctz(bits);
+      if (last < 2 || equals_folded(text.data() + position + 1,
+                                    term.data() + 1, last - 1)) {
+        return position;
+      }
+      bits &= bits - 1;
+    }
+  }
+  return find_scalar(text, term, i);
+}
+#endif
+
+/// @brief the fastest engine this CPU supports, checked once
+MatchEngine best_match_engine() {
+#ifdef TEA_X86_SIMD
+  static const MatchEngine best = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return MatchEngine::Avx2;
+    if (__builtin_cpu_supports("sse4.2")) return MatchEngine::Sse42;
+    return MatchEngine::Scalar;
+  }();
+  return best;
+#else
+  return MatchEngine::Scalar;
+#endif
+}
+
+const char* match_engine_name(MatchEngine engine) {
+  switch (engine) {
+    case MatchEngine::Avx2:
+      return "avx2";
+    case MatchEngine::Sse42:
+      return "sse4.2";
+    default:
+      return "scalar";
+  }
+}
+
+/// @brief prepares a search for the term
+/// @param term
+/// @param engine used if the CPU supports it, otherwise the scalar scan
+SubstringMatcher::SubstringMatcher(std::string_view term, MatchEngine engine)
+    : m_term(term), m_engine(engine) {
+  for (char& c : m_term) {
+    c = static_cast<char>(fold(static_cast<unsigned char>(c)));
+  }
+  if (engine > best_match_engine()) m_engine = MatchEngine::Scalar;
+}
+
+/// @brief finds the next occurrence of the term
+/// @param text
+/// @param from position to start looking at
+/// @return position of the occurrence, or npos if there is none
+size_t SubstringMatcher::find(std::string_view text, size_t from) const {
+  if (m_term.empty()) {
+    return from <= text.size() ? from : std::string_view::npos;
+  }
+  if (from >= text.size() || m_term.size() > text.size() - from) {
+    return std::string_view::npos;
+  }
+
+  switch (m_engine) {
+#ifdef TEA_X86_SIMD
+    case MatchEngine::Avx2:
+      return find_avx2(text, m_term, from);
+    case MatchEngine::Sse42:
+      return find_sse42(text, m_term, from);
+#endif
+    default:
+      return find_scalar(text, m_term, from);
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef SUBSTRING_MATCHER_HPP
+#define SUBSTRING_MATCHER_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// @brief instruction sets the matcher can scan with
+enum class MatchEngine { Scalar, Sse42, Avx2 };
+
+MatchEngine best_match_engine();
+const char* match_engine_name(MatchEngine engine);
+
+/// @brief Finds a term in text, ignoring ASCII case as LIKE does. The
+/// vector engines test the term's first and last bytes at 16 or 32
+/// positions at a time and only compare the rest at positions where both
+/// match. The best engine the CPU supports is chosen at runtime; asking for
+/// one it lacks falls back to the scalar scan.
+class SubstringMatcher {
+ public:
+  explicit SubstringMatcher(std::string_view term,
+                            MatchEngine engine = best_match_engine());
+
+  size_t find(std::string_view text, size_t from = 0) const;
+  MatchEngine engine() const { return m_engine; }
+
+ private:
+  std::string m_term;  // lower-cased
+  MatchEngine m_engine;
+};
+
+#endif
@@ -1,26 +1,37 @@
 #include "utility.hpp"
 
-#include <gtkmm/treeview.h>
+#include <gtkmm/label.h>
+#include <gtkmm/listitem.h>
 
-/// @brief adds entries to the treeview, intended purpose is searching
-/// @param entries
-/// @param refTreeModel
-/// @param colID
-/// @param colName
-/// @param colLocal
-/// @param colUtc
-void Utility::AddEntriesToTree(
-    const std::vector<TeaLogEntry>& entries,
-    Glib::RefPtr<Gtk::ListStore> refTreeModel,
-    const Gtk::TreeModelColumn<int>& colID,
-    const Gtk::TreeModelColumn<std::string>& colName,
-    const Gtk::TreeModelColumn<std::string>& colLocal,
-    const Gtk::TreeModelColumn<std::string>& colUtc) {
-  for (const auto& entry : entries) {
-    Gtk::TreeModel::Row treeRow = *(refTreeModel->append());
-    treeRow[colID] = entry.id;
-    treeRow[colName] = entry.tea_name;
-    treeRow[colLocal] = entry.local_time;
-    treeRow[colUtc] = entry.utc_time;
-  }
+#include "../models/tea_list_model.hpp"
+#include "instrumentation.hpp"
+
+/// @brief creates a list item factory showing one field of a TeaRow in a
+/// label. Labels are only created for the rows on screen and rebound as the
+/// view scrolls.
+/// @param field
+/// @return the factory, intended for a ColumnView column
+Glib::RefPtr<Gtk::SignalListItemFactory> Utility::CreateLabelFactory(
+    std::function<std::string(const TeaLogEntry&)> field) {
+  auto factory = Gtk::SignalListItemFactory::create();
+
+  factory->signal_setup().connect([](const Glib::RefPtr<Glib::Object>& object) {
+    auto list_item = std::dynamic_pointer_cast<Gtk::ListItem>(object);
+    if (!list_item) return;
+    list_item->set_child(*Gtk::make_managed<Gtk::Label>("", Gtk::Align::START));
+  });
+
+  factory->signal_bind().connect(
+      [field](const Glib::RefPtr<Glib::Object>& object) {
+        auto list_item = std::dynamic_pointer_cast<Gtk::ListItem>(object);
+        if (!list_item) return;
+        auto row = std::dynamic_pointer_cast<TeaRow>(list_item->get_item());
+        auto label = dynamic_cast<Gtk::Label*>(list_item->get_child());
+        if (row && label) {
+          ScopedTimer timer("ui.bind_row");
+          label->set_text(field(row->entry()));
+        }
+      });
+
+  return factory;
 }
@@ -1,24 +1,18 @@
 #ifndef UTILITY_HPP
 #define UTILITY_HPP
 
-#include <gtkmm/button.h>
-#include <gtkmm/liststore.h>
-#include <gtkmm/searchentry.h>
-#include <gtkmm/treeview.h>
+#include <gtkmm/signallistitemfactory.h>
 
-#include <vector>
+#include <functional>
+#include <string>
 
-#include "../db/db_handler.hpp"
+#include "../models/tea.hpp"
 
 /// @brief utility class for common helper functions
 class Utility {
  public:
-  void AddEntriesToTree(const std::vector<TeaLogEntry>& entries,
-                        Glib::RefPtr<Gtk::ListStore> refTreeModel,
-                        const Gtk::TreeModelColumn<int>& colID,
-                        const Gtk::TreeModelColumn<std::string>& colName,
-                        const Gtk::TreeModelColumn<std::string>& colLocal,
-                        const Gtk::TreeModelColumn<std::string>& colUtc);
+  static Glib::RefPtr<Gtk::SignalListItemFactory> CreateLabelFactory(
+      std::function<std::string(const TeaLogEntry&)> field);
 };
 
 #endif